@@ -0,0 +1,41 @@
+#pragma once
+
+#include "raylib.h"
+
+#include "util.h"
+#include "body.h"
+#include "quant.h"
+
+// area of interest, which dynamic bodies each client gets told about.
+// bodies are bucketed into a uniform grid over the xz plane once per broadcast,
+// then each client only walks the cells its radius touches
+
+#define AOI_HYSTERESIS 1.15f // bodies already in view stay until they're this much further out
+
+typedef struct aoiGrid {
+    f32 cellSize;
+    f32 minX, minZ;
+    i32 width, height;
+
+    i32* cellStart; // width * height + 1 offsets into cellBodies
+    i32* cellBodies;
+    i32 capacity;
+} AoiGrid;
+
+typedef struct aoiClient {
+    i32* ids; // in view as of the last update, sorted
+    i32 count;
+    i32* next; // scratch for the next update
+    u8* inView; // ids as a lookup table
+    i32 capacity;
+} AoiClient;
+
+// the grid covers bounds, anything outside lands in the edge cells
+i8 Aoi_GridInit(AoiGrid* g, i32 capacity, QuantBounds bounds, f32 cellSize);
+void Aoi_GridFree(AoiGrid* g);
+void Aoi_GridBuild(AoiGrid* g, const BodyState* states, const i32* ids, i32 count);
+
+i8 Aoi_ClientInit(AoiClient* c, i32 capacity);
+void Aoi_ClientFree(AoiClient* c);
+// radius <= 0 means everything in the grid
+void Aoi_ClientUpdate(AoiClient* c, const AoiGrid* g, const BodyState* states, Vector3 pos, f32 radius);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "util.h"
+#include "quant.h"
+#include "player.h"
+#include "world.h"
+
+// an arena is one authoritative simulation plus the enet host serving it,
+// it never touches raylib so it can run on machines without a display.
+// the enet host lives on its own network thread, the simulation runs on the
+// thread that called Arena_Run and talks to it only through two queues
+
+typedef struct arenaConfig {
+    u16 port;
+    f64 tickRate;      // physics steps per second
+    f64 broadcastRate; // snapshots per second, rounded to a whole number of ticks
+    i32 maxCatchUp;    // most ticks run back to back after a stall before time is dropped
+    QuantBounds bounds; // snapshot positions are quantized inside these
+    f32 interestRadius; // clients only hear about bodies this close to them, 0 for everything
+    f32 interestCell;   // size of the grid cells bodies are bucketed into for that
+    i32 snapshotBudget; // bytes per snapshot per client, kept under the mtu so nothing fragments
+    f64 snapshotMaxRtt; // seconds, clients with a longer round trip lose their delta baseline
+    i32 maxPlayers;     // up to PLAYER_LIMIT
+    const i8* telemetryPath; // per peer network stats every tick as json lines, see telemetry.h. NULL for none
+    WorldConfig physics;
+} ArenaConfig;
+
+#define ARENA_DEFAULT_CONFIG (ArenaConfig){ .port = 12345, .tickRate = 120.0, .broadcastRate = 60.0, .maxCatchUp = 5, .bounds = QUANT_DEFAULT_BOUNDS, .interestRadius = 48.f, .interestCell = 8.f, .snapshotBudget = 1200, .snapshotMaxRtt = 1.5, .maxPlayers = DEFAULT_MAX_PLAYERS, .physics = WORLD_DEFAULT_CONFIG }
+
+typedef struct arenaStats {
+    u64 ticks;
+    u64 overruns;
+    u64 droppedTicks;
+    i32 players;
+    i32 bodies;
+    i32 awakeBodies; // as of the last broadcast, the rest are asleep and cost next to nothing
+    u32 contacts;  // contact joints in the last step
+    u8 quickStep;  // the last step used dWorldQuickStep
+
+    u64 snapshotBytes;      // encoded snapshot bytes for all clients on the last broadcast tick
+    u64 snapshotBytesTotal;
+    u32 interestBodies; // bodies in view summed over all clients on the last broadcast tick
+    u32 deferredBodies; // changes that didn't fit in a client's budget on the last broadcast tick
+
+    // network thread -> simulation commands and simulation -> network packets,
+    // overflows are items dropped because the queue was full
+    u32 cmdQueueDepth, cmdQueuePeak, cmdOverflows;
+    u32 outQueueDepth, outQueuePeak, outOverflows;
+
+    // the connected peer with the highest round trip, as last sampled by the network thread
+    i32 worstPeer; // -1 if nobody is connected
+    u32 worstRtt;  // ms
+    f32 worstLoss; // 0 to 1
+} ArenaStats;
+
+// called once per tick batch on the arena's thread, return nonzero to stop
+typedef i8 (*ArenaFrameFn)(const ArenaStats* stats, void* user);
+
+// blocks until the frame callback or Arena_RequestStop asks it to stop,
+// returns nonzero if the arena couldn't be started
+i8 Arena_Run(const ArenaConfig* config, ArenaFrameFn onFrame, void* user);
+
+// safe to call from a signal handler
+void Arena_RequestStop(void);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "util.h"
+
+// bit packed reading and writing, least significant bit first so the layout
+// doesn't depend on the host's byte order or struct padding.
+// neither side ever touches memory past size, a write that doesn't fit sets
+// overflow and a read past the end sets failed and returns 0 from then on,
+// so callers can read a whole message and check once at the end
+
+typedef struct bitWriter {
+    u8* data;
+    size_t size; // bytes
+    size_t bits; // written so far
+    i8 overflow;
+} BitWriter;
+
+typedef struct bitReader {
+    const u8* data;
+    size_t size; // bytes
+    size_t bits; // read so far
+    i8 failed;
+} BitReader;
+
+// bits needed for any value in [min, max]
+i32 Bits_Range(i32 min, i32 max);
+
+void Bits_WriterInit(BitWriter* w, u8* data, size_t size);
+void Bits_Write(BitWriter* w, u32 value, i32 count); // count from 1 to 32
+void Bits_WriteRange(BitWriter* w, i32 value, i32 min, i32 max);
+void Bits_WriteF32(BitWriter* w, f32 value);
+size_t Bits_WriterBytes(const BitWriter* w); // rounded up to whole bytes
+
+// reads straight out of data, nothing is copied
+void Bits_ReaderInit(BitReader* r, const u8* data, size_t size);
+u32 Bits_Read(BitReader* r, i32 count);
+i32 Bits_ReadRange(BitReader* r, i32 min, i32 max); // fails if the value is out of range
+f32 Bits_ReadF32(BitReader* r); // fails on nan and inf
+// nonzero if nothing failed and the message used up every whole byte,
+// trailing garbage means the sender and receiver disagree about the layout
+i8 Bits_ReaderDone(const BitReader* r);
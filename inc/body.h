@@ -3,7 +3,10 @@
 #include "raylib.h"
 #include "ode/common.h"
 
+#include "util.h"
+
 #define MAX_BODIES 512
+#define MAX_BODY_SIZE 8.f // meters on a side, or the radius for spheres
 
 typedef enum collMask {
     CMASK_MAP = 1,
@@ -28,8 +31,19 @@ typedef struct bodyState {
     dReal transform[16];
     Vector3 size;
     Color col;
+    u8 isStatic; // map geometry, never moves so it's only sent once
+    u8 isAwake;  // not put to sleep by ode, on clients as of the last snapshot. always 0 for static bodies
 } BodyState;
 
+// spheres only use size.x, the radius. written so nan fails too
+static inline i8 Body_ValidSize(BodyType type, Vector3 size, f32 maxSize) {
+    const i8 x = size.x > 0.f && size.x <= maxSize;
+    if (BODYTYPE_SPHERE == type) {
+        return x;
+    }
+    return x && size.y > 0.f && size.y <= maxSize && size.z > 0.f && size.z <= maxSize;
+}
+
 typedef struct renderBody {
     BodyState state;
     Model display;
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "util.h"
+
+// one direction of a simulated bad link. packets go in with the time they were sent
+// and come out when they'd have arrived, or never. every random choice comes from the
+// link's own seeded generator and the packet's place in the stream, not from the clock,
+// so the same traffic through the same profile is lost and duplicated the same way every run
+
+typedef struct impairSettings {
+    f32 latency;   // one way, seconds
+    f32 jitter;    // up to this much more, seconds. doesn't reorder by itself
+    f32 loss;      // chance of dropping a packet, 0 to 1
+    f32 duplicate; // chance of sending it twice
+    f32 reorder;   // chance of holding it back so the ones after it overtake it
+    f32 rate;      // bytes per second, 0 for unlimited
+    f32 queueTime; // seconds of data the rate limit buffers before dropping what doesn't fit
+} ImpairSettings;
+
+#define IMPAIR_NONE ((ImpairSettings){ .queueTime = 0.2f })
+
+// settings that change over time, each step applies from its time until the next one
+typedef struct impairStep {
+    f64 time; // seconds since the profile started
+    ImpairSettings settings;
+} ImpairStep;
+
+typedef struct impairProfile {
+    ImpairStep* steps; // by time
+    i32 count;
+} ImpairProfile;
+
+// one line per step, "<seconds> key=value ...", # starts a comment.
+// keys are latency and jitter in ms, loss, dup and reorder in percent, rate in kbit/s and
+// queue in ms. anything a line leaves out keeps its value from the step before, the first
+// step starts from base. returns nonzero and logs the line if it can't be read
+i8 Impair_LoadProfile(ImpairProfile* p, const i8* path, ImpairSettings base);
+void Impair_FreeProfile(ImpairProfile* p);
+// the settings in force at time, base if the profile is empty or hasn't started
+ImpairSettings Impair_ProfileAt(const ImpairProfile* p, f64 time, ImpairSettings base);
+
+// parses one "key=value" into s, returns nonzero if the key is unknown or the value is out of range
+i8 Impair_ParseSetting(ImpairSettings* s, const i8* key, const i8* value);
+
+typedef struct impairPacket {
+    f64 due;
+    u32 order; // ties on due go out in the order they were queued
+    u8* data;
+    size_t len;
+} ImpairPacket;
+
+typedef struct impairStats {
+    u64 packetsIn, packetsOut;
+    u64 bytesIn, bytesOut;
+    u64 lost, duplicated, reordered;
+    u64 overflowed; // dropped by the rate limit
+} ImpairStats;
+
+typedef struct impairLink {
+    ImpairSettings settings; // may be changed between pushes
+    u64 rng;
+    u32 nextOrder;
+    f64 busyUntil;   // when the rate limit has sent everything queued so far
+    f64 lastInOrder; // due time of the newest packet that wasn't reordered, later ones never beat it
+
+    ImpairPacket* heap; // min heap on due
+    i32 count, capacity;
+
+    ImpairStats stats;
+} ImpairLink;
+
+void Impair_Init(ImpairLink* l, ImpairSettings settings, u64 seed);
+void Impair_Free(ImpairLink* l);
+
+// copies data, returns nonzero if it couldn't be queued for lack of memory
+i8 Impair_Push(ImpairLink* l, const u8* data, size_t len, f64 now);
+// pops the next packet due at or before now into res, which the caller frees. returns 0 if none is
+i8 Impair_Pop(ImpairLink* l, f64 now, ImpairPacket* res);
+// when the next packet is due, or a negative number if nothing is queued
+f64 Impair_NextDue(const ImpairLink* l);
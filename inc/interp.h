@@ -0,0 +1,36 @@
+#pragma once
+
+#include "util.h"
+#include "body.h"
+
+// client side, renders bodies a little in the past so there are always two
+// snapshots to blend between, which hides jitter and lets frames between
+// snapshots move smoothly instead of redrawing the same pose.
+// the delay grows with how unevenly snapshots arrive and never drops below minDelay
+
+#define INTERP_FRAMES 16
+
+typedef struct interpBuffer {
+    BodyState* frames[INTERP_FRAMES];
+    u32 ticks[INTERP_FRAMES];
+    i32 newest, count;
+    i32 capacity;
+
+    f64 tickTime; // seconds per server tick
+    f64 minDelay;
+    f64 delay;    // how far behind the estimated server time rendering is
+
+    // all in seconds, smoothed over the last few snapshots
+    f64 offset;   // local time minus server time
+    f64 jitter;   // mean deviation of arrival times from offset
+    f64 interval; // time between snapshots
+} InterpBuffer;
+
+i8 Interp_Init(InterpBuffer* b, i32 capacity, f64 tickTime, f64 minDelay);
+void Interp_Free(InterpBuffer* b);
+
+// ticks have to increase, now is the local time the snapshot arrived
+void Interp_Push(InterpBuffer* b, const BodyState* states, u32 tick, f64 now);
+
+// fills res with every body as of now - delay, returns 0 if nothing has been pushed yet
+i8 Interp_Sample(InterpBuffer* b, f64 now, BodyState* res);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "util.h"
+
+typedef enum logLevel {
+    LOGLEVEL_DEBUG,
+    LOGLEVEL_INFO,
+    LOGLEVEL_WARN,
+    LOGLEVEL_ERROR
+} LogLevel;
+
+extern LogLevel logMinLevel;
+
+// writes one logfmt line: ts=... lvl=... evt=<event> <fmt...>
+// fmt should itself be space separated key=value pairs
+void Log_Write(LogLevel level, const i8* event, const i8* fmt, ...);
+
+// last line written, without the timestamp, for on-screen status displays.
+// safe to call while other threads log but the result is only valid until the next call
+const i8* Log_Last(void);
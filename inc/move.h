@@ -0,0 +1,72 @@
+#pragma once
+
+#include <math.h>
+
+#include "util.h"
+#include "player.h"
+#include "quant.h"
+
+// player movement, shared by the server which runs it authoritatively and the
+// client which runs the same inputs ahead of the server to hide the round trip.
+// it has to stay deterministic and free of raylib calls, the dedicated server links it
+
+#define MOVE_DT (1.f / 60.f) // every input covers exactly this much time
+#define MOVE_SPEED 2.f
+#define TURN_SPEED 2.f // radians per second, turning is client side and only the angles are sent
+#define MOVE_MAX_PITCH (89.f * DEG2RAD)
+
+#define MOVE_HISTORY 128   // unacked inputs kept for replay, a bit over two seconds
+#define MOVE_MAX_INPUTS 32 // most inputs one message carries, the newest unacked ones are repeated in every message
+
+typedef enum inputButton {
+    INPUT_FORWARD    = 1 << 0,
+    INPUT_BACK       = 1 << 1,
+    INPUT_LEFT       = 1 << 2,
+    INPUT_RIGHT      = 1 << 3,
+    INPUT_DOWN       = 1 << 4,
+    INPUT_UP         = 1 << 5,
+    INPUT_SPRINT     = 1 << 6
+} InputButton;
+
+#define INPUT_BUTTON_BITS 7
+
+typedef struct playerInput {
+    u32 seq;        // the input tick, starts at 1 and counts MOVE_DT steps
+    u16 buttons;    // InputButton mask
+    u16 yaw, pitch; // view angles at the end of the step, see Quant_PackYaw and Quant_PackPitch
+} PlayerInput;
+
+static inline Vector3 Move_Direction(f32 yaw, f32 pitch) {
+    return (Vector3){ cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw) };
+}
+
+// where every player starts, the client predicts from here until the server says otherwise
+void Move_Spawn(PlayerState* p);
+
+// advances p by one input
+void Move_Simulate(PlayerState* p, const PlayerInput* in);
+
+// client side, inputs the server hasn't applied yet and the state predicted from them
+typedef struct movePredictor {
+    PlayerInput inputs[MOVE_HISTORY]; // indexed by seq % MOVE_HISTORY
+    u32 nextSeq;
+    u32 sentSeq;  // newest seq returned by Move_NextInputs
+    u32 ackedSeq; // newest seq the server has applied, or that wouldn't have changed anything
+    PlayerState state; // after the newest input
+    PlayerState prev;  // before it, drawing blends the two
+    f32 accumulator;
+} MovePredictor;
+
+void Move_PredictorInit(MovePredictor* m, const PlayerState* start);
+
+// cuts dt of holding buttons into MOVE_DT inputs and predicts each of them.
+// returns how far between prev and state the current moment is
+f32 Move_Predict(MovePredictor* m, u16 buttons, f32 yaw, f32 pitch, f32 dt);
+
+// fills res with the next message's worth of consecutive inputs, oldest first, and returns how many.
+// every message takes as many unsent inputs as fit and fills the rest with the unacked ones
+// before them, so losing a packet doesn't lose inputs. call until it returns 0, an idle player sends nothing
+i32 Move_NextInputs(MovePredictor* m, PlayerInput* res, i32 max);
+
+// server is the authoritative state after its lastInput, replays everything newer on top of it
+void Move_Reconcile(MovePredictor* m, const PlayerState* server);
@@ -1,38 +1,133 @@
 #pragma once
 
+#include <stddef.h>
+
+#include "util.h"
 #include "body.h"
 #include "player.h"
+#include "move.h"
+#include "quant.h"
+
+// every message is bit packed with bits.h, never sent as a raw struct, so the
+// layout doesn't depend on padding or sizeof(dReal). the first 8 bits are the MsgType.
+// the structs below are only the decoded form
+
+// sent as the enet connect data, the server turns away anything else.
+// bump it whenever any message layout changes
+#define PROTOCOL_VERSION 9
+
+// how far a client's rotation matrix may be from orthonormal, it's sent as f32
+#define MSG_ROT_TOLERANCE 1e-3f
+
+// biggest fixed layout message, snapshots and the level have their own sizes in snapshot.h
+// and player updates grow with the server's capacity, see Msg_UpdatePlayersMaxSize
+#define MSG_MAX_SIZE 1024
+
+// per tick state goes on the unreliable sequenced channel so one lost packet
+// doesn't hold up every newer one behind it, enet drops anything older than
+// what it already delivered on that channel. everything that happens once
+// (ids, the level, spawns) goes on the reliable channel
+typedef enum netChannel {
+    CHANNEL_RELIABLE,
+    CHANNEL_STATE,
+    CHANNEL_COUNT
+} NetChannel;
+
+// the data of the disconnect event the server sends when it turns someone away
+typedef enum disconnectReason {
+    DISCONNECT_NONE,
+    DISCONNECT_FULL,
+    DISCONNECT_VERSION,
+    DISCONNECT_SERVER_ERROR // the server couldn't set the player up after all
+} DisconnectReason;
 
 typedef enum msgType {
     MSGTYPE_C_PLAYER_ID,
     MSGTYPE_C_UPDATE_PLAYERS,
-    MSGTYPE_S_PLAYER_UPDATE,
+    MSGTYPE_S_PLAYER_INPUT,
+
+    MSGTYPE_C_SNAPSHOT, // variable length, see snapshot.h
+    MSGTYPE_S_NEW_BODY,
+    MSGTYPE_S_SNAPSHOT_ACK,
+    MSGTYPE_C_LEVEL_LOAD, // variable length, see snapshot.h
+    MSGTYPE_C_SERVER_STATS,
 
-    MSGTYPE_C_UPDATE_BODIES,
-    MSGTYPE_S_NEW_BODY
+    MSGTYPE_COUNT
 } MsgType;
 
+#define MSGTYPE_BITS 8
+
 typedef struct msgPlayerID {
-    MsgType msg;
     i32 playerID;
+    i32 maxPlayers;     // slots on the server, player ids and updates are sized by it
+    QuantBounds bounds; // snapshot positions are quantized inside these
+    f32 tickTime;       // seconds per server tick, snapshots are stamped with ticks
+    i32 snapshotHistory; // snapshots the client has to keep for the server to delta against
 } MsgPlayerID;
 
-typedef struct msgPlayerUpdate {
-    MsgType msg;
-    PlayerState player;
-} MsgPlayerUpdate;
+// consecutive inputs, oldest first, only the newest seq is sent. the unacked
+// ones get repeated until they're acked so the server skips seqs it already has.
+// the player isn't sent, the server knows who it came from
+typedef struct msgPlayerInput {
+    i32 count;
+    PlayerInput inputs[MOVE_MAX_INPUTS];
+} MsgPlayerInput;
 
+// only the players that changed since the last one, or every connected player if full is set,
+// in which case any slot that isn't in it is empty. dir is rebuilt from yaw and pitch.
+// the arrays belong to the caller and need room for capacity entries
 typedef struct msgUpdatePlayers {
-    MsgType msg;
-    PlayerState players[MAX_PLAYERS];
+    u8 full;
+    i32 capacity; // the server's maxPlayers, slots are below it
+    i32 count;
+    i32* slots;   // increasing
+    PlayerState* players; // id -1 if the slot emptied
 } MsgUpdatePlayers;
 
-typedef struct msgBodyInfo {
-    MsgType msg;
-    BodyState bodies[MAX_BODIES];
-} MsgUpdateBodies;
-
 typedef struct msgNewBody {
-    MsgType msg;
     BodyState body;
 } MsgNewBody;
+
+typedef struct msgSnapshotAck {
+    u32 seq;
+} MsgSnapshotAck;
+
+// sent with every full player update so clients can tell a stalling server from a bad
+// connection. snapshots only carry ticks that ran, the dropped ones just never show up
+typedef struct msgServerStats {
+    u32 tick;
+    u32 overruns;     // since the server started, see TickClock
+    u32 droppedTicks;
+} MsgServerStats;
+
+// the message's type, or -1 if it's empty or not one we know
+i32 Msg_Type(const u8* data, size_t len);
+// short lowercase name for logs, "unknown" for anything out of range
+const i8* Msg_TypeName(i32 type);
+
+// writers return the number of bytes written, or 0 if buf was too small.
+// readers return nonzero if the message is truncated, has trailing bytes or
+// anything in it is out of range, in which case res is garbage
+size_t Msg_WritePlayerID(u8* buf, size_t size, const MsgPlayerID* msg);
+i8 Msg_ReadPlayerID(const u8* data, size_t len, MsgPlayerID* res);
+
+// fills res with the players whose bit is set in dirty, or with every connected one if full.
+// players has res->capacity entries
+void Msg_CollectPlayers(MsgUpdatePlayers* res, const PlayerState* players, const u32* dirty, u8 full);
+size_t Msg_UpdatePlayersMaxSize(i32 capacity);
+size_t Msg_WriteUpdatePlayers(u8* buf, size_t size, const MsgUpdatePlayers* msg);
+i8 Msg_ReadUpdatePlayers(const u8* data, size_t len, MsgUpdatePlayers* res);
+
+size_t Msg_WritePlayerInput(u8* buf, size_t size, const MsgPlayerInput* msg);
+i8 Msg_ReadPlayerInput(const u8* data, size_t len, MsgPlayerInput* res);
+
+// also rejects bodies bigger than MAX_BODY_SIZE, outside bounds or with a rotation
+// that isn't orthonormal to within MSG_ROT_TOLERANCE
+size_t Msg_WriteNewBody(u8* buf, size_t size, const MsgNewBody* msg);
+i8 Msg_ReadNewBody(const u8* data, size_t len, const QuantBounds* bounds, MsgNewBody* res);
+
+size_t Msg_WriteSnapshotAck(u8* buf, size_t size, const MsgSnapshotAck* msg);
+i8 Msg_ReadSnapshotAck(const u8* data, size_t len, MsgSnapshotAck* res);
+
+size_t Msg_WriteServerStats(u8* buf, size_t size, const MsgServerStats* msg);
+i8 Msg_ReadServerStats(const u8* data, size_t len, MsgServerStats* res);
@@ -5,15 +5,29 @@
 
 #include "util.h"
 
-#define MAX_PLAYERS 32
+#define DEFAULT_MAX_PLAYERS 32
+#define PLAYER_LIMIT 4095 // most peers one enet host can have
+
+// one bit per player slot, n slots need this many u32s
+#define PLAYER_MASK_WORDS(n) (((n) + 31) / 32)
+#define PLAYER_MASK_SET(mask, i) ((mask)[(i) / 32] |= 1u << ((i) % 32))
+#define PLAYER_MASK_HAS(mask, i) ((mask)[(i) / 32] >> ((i) % 32) & 1u)
 
 typedef struct playerState {
     Vector3 pos, dir;
+    f32 yaw, pitch;
+    f32 sprint;    // grows the longer sprint is held
+    u32 lastInput; // seq of the newest input applied, the owner replays everything after it
     i32 id;
 } PlayerState;
 
-extern PlayerState players[MAX_PLAYERS];
+// playerCapacity of them, allocated once the server says how many it takes
+extern PlayerState* players;
+extern i32 playerCapacity;
 extern i32 localID;
 extern Camera playerCam;
 
-void Player_UpdateLocal(f32 moveSpeed, f32 turnSpeed, f32 dt);
+struct movePredictor;
+
+// predicts the local player from the held keys, see move.h, and moves the camera with it
+void Player_UpdateLocal(struct movePredictor* m, f32 dt);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "util.h"
+
+// scoped timing zones around the hot paths. each zone keeps a smoothed per frame
+// time for on-screen overlays, and while a capture is running every begin/end pair
+// is also recorded so it can be written out as a chrome trace_event json file
+// (open it in chrome://tracing or ui.perfetto.dev).
+// build with -DPROF_DISABLE to compile every PROF_BEGIN and PROF_END away.
+// zones can nest but not recurse
+
+typedef enum profZone {
+    PROF_COLLIDE,         // dSpaceCollide
+    PROF_WORLD_STEP,      // dWorldStep or dWorldQuickStep
+    PROF_EXTRACT,         // body transforms out of ode
+    PROF_BROADCAST,       // snapshot encoding and packet creation
+    PROF_SNAPSHOT_DECODE, // client side
+    PROF_SHADOW_PASS,     // cpu side only, the gpu runs behind
+    PROF_DRAW_SCENE,
+    PROF_ZONE_COUNT
+} ProfZone;
+
+#define PROF_MAX_EVENTS (1 << 18) // a capture stops recording once it has this many
+
+#ifdef PROF_DISABLE
+    #define PROF_BEGIN(zone) ((void)0)
+    #define PROF_END(zone) ((void)0)
+#else
+    #define PROF_BEGIN(zone) Prof_Begin(zone)
+    #define PROF_END(zone) Prof_End(zone)
+#endif
+
+void Prof_Begin(ProfZone zone);
+void Prof_End(ProfZone zone);
+
+// call once per frame or tick batch. the overlay numbers only cover zones that ran on the calling thread
+void Prof_FrameEnd(void);
+
+const i8* Prof_ZoneName(ProfZone zone);
+// milliseconds per frame, smoothed over the last few dozen frames
+f64 Prof_Average(ProfZone zone);
+// how many times the zone ran in the last frame
+u32 Prof_Calls(ProfZone zone);
+
+i8 Prof_Capturing(void);
+// starts a capture, or stops the running one and writes it to trace_<date>_<time>.json
+// in the working directory. returns nonzero and logs if that fails
+i8 Prof_ToggleCapture(void);
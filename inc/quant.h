@@ -0,0 +1,34 @@
+#pragma once
+
+#include "raylib.h"
+#include "ode/common.h"
+
+#include "util.h"
+
+// compact wire encodings for BodyState.transform:
+// position as fixed point inside the world bounds, rotation as a smallest three quaternion.
+// view angles for player inputs are fixed point too
+
+#define QUANT_POS_BITS 16
+#define QUANT_ROT_BITS 10 // per component, plus 2 for which one was dropped
+#define QUANT_ANGLE_BITS 16
+
+typedef struct quantBounds {
+    Vector3 min, max;
+} QuantBounds;
+
+// roomy enough for the default map, bodies outside get clamped to the edge
+#define QUANT_DEFAULT_BOUNDS (QuantBounds){ .min = {-64.f, -16.f, -64.f}, .max = {64.f, 112.f, 64.f} }
+
+void Quant_PackPos(u16 res[3], const dReal trans[16], const QuantBounds* bounds);
+void Quant_UnpackPos(dReal trans[16], const u16 pos[3], const QuantBounds* bounds);
+
+u32 Quant_PackRot(const dReal trans[16]);
+// also fills in the constant last row and column
+void Quant_UnpackRot(dReal trans[16], u32 rot);
+
+// yaw wraps around and unpacks into [0, 2pi), pitch is clamped to +-maxPitch
+u16 Quant_PackYaw(f32 yaw);
+f32 Quant_UnpackYaw(u16 yaw);
+u16 Quant_PackPitch(f32 pitch, f32 maxPitch);
+f32 Quant_UnpackPitch(u16 pitch, f32 maxPitch);
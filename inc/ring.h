@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include "util.h"
+
+// lock free single producer single consumer queue of fixed size items,
+// one thread may only push and one other thread may only pop
+
+typedef struct ring {
+    u8* items;
+    u32 itemSize;
+    u32 mask;
+
+    // padded apart so the two threads don't fight over one cache line
+    u8 pad0[64];
+    _Atomic u32 head;      // next slot to write, producer owned
+    _Atomic u32 overflows; // pushes rejected because the ring was full
+    _Atomic u32 peakDepth;
+    u8 pad1[64];
+    _Atomic u32 tail;      // next slot to read, consumer owned
+    u8 pad2[64];
+} Ring;
+
+// capacity is rounded up to a power of two
+i8 Ring_Init(Ring* r, u32 itemSize, u32 capacity);
+void Ring_Free(Ring* r);
+
+// returns 0 and counts an overflow if the ring is full
+i8 Ring_Push(Ring* r, const void* item);
+// returns 0 if the ring is empty
+i8 Ring_Pop(Ring* r, void* item);
+
+// safe to call from either thread, may be stale by the time it returns
+u32 Ring_Depth(Ring* r);
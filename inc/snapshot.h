@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "util.h"
+#include "body.h"
+#include "quant.h"
+
+// body snapshots delta encoded against the last one the client acked
+//
+// wire layout, bit packed with bits.h, an id takes just enough bits for capacity - 1:
+//   8 msg (MSGTYPE_C_SNAPSHOT), 32 seq, 32 baselineSeq (0 for none), 32 server tick, 16 count
+//   count times: id, 5 fields, then for each set field in this order:
+//     SNAPFIELD_SPAWN: 1 type, f32 size[3], 32 rgba
+//     SNAPFIELD_POS:   16 pos[3], see Quant_PackPos
+//     SNAPFIELD_ROT:   32 rot, see Quant_PackRot
+// bodies whose quantized transform didn't change since the baseline aren't written at all.
+// SNAPFIELD_SLEEP has no payload, it's set on every entry for a body that's asleep. a body
+// that falls asleep is sent once more with its final pose and then not again until it wakes.
+// a body that leaves a client's area of interest gets SNAPFIELD_REMOVE and spawns again
+// if it comes back
+//
+// static bodies never show up in snapshots, they're sent once in a level message:
+//   8 msg (MSGTYPE_C_LEVEL_LOAD), 16 count
+//   count times: id, 1 type, f32 size[3], 32 rgba, f32 pos[3], f32 rot[9]
+
+// how many snapshots both ends keep. an ack has to come back before the snapshot it's for
+// falls out of the history or the next one has no baseline and starts the client over,
+// so the server sizes it from the round trip it wants to cover, see Snapshot_HistoryFor,
+// and tells clients in MsgPlayerID
+#define SNAPSHOT_MIN_HISTORY 8
+#define SNAPSHOT_MAX_HISTORY 1024
+
+typedef enum snapField {
+    SNAPFIELD_SPAWN  = 1 << 0,
+    SNAPFIELD_POS    = 1 << 1,
+    SNAPFIELD_ROT    = 1 << 2,
+    SNAPFIELD_REMOVE = 1 << 3,
+    SNAPFIELD_SLEEP  = 1 << 4
+} SnapField;
+
+#define SNAPFIELD_BITS 5
+
+// the quantized state of one body
+typedef struct netBody {
+    u8 present;
+    u8 asleep;
+    u16 pos[3];
+    u32 rot;
+} NetBody;
+
+// server side, the quantized state of every body this tick, shared by all clients
+typedef struct snapSource {
+    NetBody* bodies;
+    const BodyState* states;
+    i32 capacity;
+    QuantBounds bounds;
+    u32 tick; // server tick the states are from
+} SnapSource;
+
+// what the client has after applying a snapshot, only the bodies it knows about
+typedef struct snapFrame {
+    u32 seq; // 0 for unused
+    i32 count;
+    u16* ids; // sorted
+    NetBody* bodies; // parallel to ids
+} SnapFrame;
+
+// scratch for one body while a snapshot is being packed
+typedef struct snapPending {
+    i32 id;
+    u8 fields;
+    u8 send;
+    const NetBody* cur;  // NULL if it isn't in view anymore
+    const NetBody* sent; // NULL if the baseline doesn't have it
+} SnapPending;
+
+typedef struct snapRank {
+    f32 priority;
+    i32 pending;
+} SnapRank;
+
+// server side, one per connected client
+typedef struct snapClient {
+    SnapFrame* frames;
+    i32 history;
+    i32 capacity;
+    size_t budget; // most bytes one snapshot may take, changes past it wait for the next one
+    u32 nextSeq;
+    u32 ackedSeq; // 0 until the first ack
+
+    f32* priority; // per body, grows every snapshot a change is left out of
+    SnapPending* pending;
+    SnapRank* order;
+    u32 deferred; // changes left out of the last snapshot
+} SnapClient;
+
+// client side, the fully applied state of the last few snapshots
+typedef struct snapReceiver {
+    u32* seqs;
+    BodyState** frames;
+    i32 history;
+    BodyState* scratch; // snapshots are decoded here and only swapped into frames once they check out
+    QuantBounds bounds;
+    i32 capacity;
+    u32 latestSeq;
+    u32 latestTick; // server tick of latestSeq
+} SnapReceiver;
+
+i8 Snapshot_SourceInit(SnapSource* src, i32 capacity, QuantBounds bounds);
+void Snapshot_SourceFree(SnapSource* src);
+// requantizes the awake bodies in ids and the ones that just fell asleep, sleeping ones keep what they had
+void Snapshot_SourceUpdate(SnapSource* src, const BodyState* states, const i32* ids, i32 count, u32 tick);
+
+// enough history to delta against acks that take up to maxRtt seconds at this many snapshots
+// per second, clamped to SNAPSHOT_MIN_HISTORY..SNAPSHOT_MAX_HISTORY
+i32 Snapshot_HistoryFor(f64 maxRtt, f64 broadcastRate);
+
+// budget is clamped so at least one body always fits
+i8 Snapshot_ClientInit(SnapClient* c, i32 capacity, i32 history, size_t budget);
+void Snapshot_ClientFree(SnapClient* c);
+void Snapshot_ClientAck(SnapClient* c, u32 seq);
+
+// writes the next snapshot for this client into buf with just the bodies in visible,
+// which has to be sorted. when the changes don't all fit in the budget the ones with the
+// highest accumulated priority go first, weighted by distance from viewPos.
+// returns the number of bytes written or 0 if buf is too small
+size_t Snapshot_Encode(SnapClient* c, const SnapSource* src, const i32* visible, i32 visibleCount, Vector3 viewPos, u8* buf, size_t bufSize);
+
+// big enough for a snapshot or level message with every body spawning in it
+size_t Snapshot_MaxSize(i32 capacity);
+
+// bounds and history have to match the server's, it sends them in MsgPlayerID
+i8 Snapshot_ReceiverInit(SnapReceiver* r, i32 capacity, i32 history, QuantBounds bounds);
+void Snapshot_ReceiverFree(SnapReceiver* r);
+
+// applies a snapshot and returns its seq, which should be acked, or 0 if it was
+// malformed or its baseline is gone. reads straight out of data
+u32 Snapshot_Decode(SnapReceiver* r, const u8* data, size_t len);
+
+// full body states as of the newest decoded snapshot
+const BodyState* Snapshot_Latest(const SnapReceiver* r);
+
+size_t Snapshot_EncodeLevel(const BodyState* states, i32 capacity, u8* buf, size_t bufSize);
+// writes the static bodies into states, returns how many or -1 if malformed
+i32 Snapshot_DecodeLevel(BodyState* states, i32 capacity, const u8* data, size_t len);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "enet/enet.h"
+
+#include "util.h"
+#include "msgs.h"
+
+// per peer network counters taken from enet plus our own per channel and per message
+// type accounting, owned by the arena's network thread. when given a path every sample
+// is appended to it as one json object per line so it can be plotted or diffed afterwards:
+//   {"type":"peer","t":1.250,"tick":150,"peer":3,"rtt_ms":24,...}  every tick for every peer
+//   {"type":"sizes","t":1.000,"tick":120,"msg":"snapshot",...}    every TELEMETRY_SIZES_TIME
+// byte and packet counts are totals since the peer connected, diff them for rates
+
+#define TELEMETRY_SIZE_BUCKETS 8 // message sizes, 0 is under 64 bytes, i counts [64 << (i - 1), 64 << i), the last one everything bigger
+#define TELEMETRY_SIZES_TIME 1.0 // seconds between size histogram lines
+
+typedef struct peerTelemetry {
+    u64 bytesSent[CHANNEL_COUNT];
+    u64 bytesReceived[CHANNEL_COUNT];
+    u64 packetsSent[CHANNEL_COUNT];
+    u64 packetsReceived[CHANNEL_COUNT];
+    u32 peakRtt; // ms
+} PeerTelemetry;
+
+typedef struct telemetry {
+    FILE* out; // NULL if nothing is exported, the counters still run
+    f64 start;
+    f64 nextSizes;
+
+    PeerTelemetry* peers; // by slot
+    i32 capacity;
+
+    // by message type, payload sizes only
+    u64 sentSizes[MSGTYPE_COUNT][TELEMETRY_SIZE_BUCKETS];
+    u64 receivedSizes[MSGTYPE_COUNT][TELEMETRY_SIZE_BUCKETS];
+
+    // the connected peer with the highest round trip as of the last sample, -1 if none
+    i32 worstPeer;
+    u32 worstRtt;  // ms
+    u32 worstLoss; // out of ENET_PEER_PACKET_LOSS_SCALE
+} Telemetry;
+
+// path may be NULL. returns nonzero if the file can't be opened or memory runs out
+i8 Telemetry_Init(Telemetry* t, const i8* path, i32 capacity);
+// logs the size histograms one last time and closes the file
+void Telemetry_Free(Telemetry* t);
+
+// a slot was handed to a new peer
+void Telemetry_ResetPeer(Telemetry* t, i32 slot);
+// slot is -1 for packets that don't belong to a player yet
+void Telemetry_CountSent(Telemetry* t, i32 slot, u8 channel, const u8* data, size_t len);
+void Telemetry_CountReceived(Telemetry* t, i32 slot, u8 channel, const u8* data, size_t len);
+
+// writes one line per connected peer, peers has capacity entries and NULL for empty slots
+void Telemetry_Sample(Telemetry* t, u64 tick, ENetPeer* const* peers, f64 now);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "util.h"
+
+// fixed rate tick scheduler on the monotonic clock
+
+typedef struct tickClock {
+    f64 tickTime;   // seconds per tick
+    i32 maxCatchUp; // most ticks run back to back before time gets dropped
+    f64 nextTick;   // monotonic time the next tick is due
+
+    u64 ticks;
+    u64 overruns;     // times we fell more than maxCatchUp ticks behind
+    u64 droppedTicks; // ticks skipped because of those overruns
+} TickClock;
+
+// monotonic time in seconds, only meaningful relative to other calls
+f64 Tick_Now(void);
+
+void Tick_Init(TickClock* c, f64 rate, i32 maxCatchUp);
+
+// how many ticks are due right now, never more than maxCatchUp,
+// the clock assumes the caller runs all of them
+i32 Tick_Due(TickClock* c);
+
+// seconds until the next tick is due, 0 if one already is
+f64 Tick_Remaining(const TickClock* c);
+
+void Tick_SleepUntil(f64 time);
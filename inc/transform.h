@@ -0,0 +1,71 @@
+#pragma once
+
+#include <math.h>
+
+#include "raylib.h"
+#include "ode/common.h"
+
+#include "util.h"
+
+static inline void GetTransformMat(dReal res[16], const dReal* pos, const dReal* rot) {
+    res[0] = rot[0];
+    res[1] = rot[4];
+    res[2] = rot[8];
+    res[3] = 0.0;
+
+    res[4] = rot[1];
+    res[5] = rot[5];
+    res[6] = rot[9];
+    res[7] = 0.0;
+
+    res[8] = rot[2];
+    res[9] = rot[6];
+    res[10] = rot[10];
+    res[11] = 0.0;
+
+    res[12] = pos[0];
+    res[13] = pos[1];
+    res[14] = pos[2];
+    res[15] = 1.0;
+}
+
+static inline void GetTransformMatV(dReal res[16], Vector3 pos, Vector3 rot) {
+    const dReal cx = cos(rot.x);
+    const dReal sx = sin(rot.x);
+    const dReal cy = cos(rot.y);
+    const dReal sy = sin(rot.y);
+    const dReal cz = cos(rot.z);
+    const dReal sz = sin(rot.z);
+
+    res[0] = cy * cz;
+    res[1] = cz * sx * sy - cx * sz;
+    res[2] = cx * cz * sy + sx * sz;
+    res[3] = 0.0;
+
+    res[4] = cy * sz;
+    res[5] = cx * cz + sx * sy * sz;
+    res[6] = -cz * sx + cx * sy * sx;
+    res[7] = 0.0;
+
+    res[8] = -sy;
+    res[9] = cy * sx;
+    res[10] = cx * cy;
+    res[11] = 0.0;
+
+    res[12] = pos.x;
+    res[13] = pos.y;
+    res[14] = pos.z;
+    res[15] = 1.0;
+}
+
+static inline void GetTransMatPos(dReal res[3], const dReal trans[16]) {
+    res[0] = trans[12];
+    res[1] = trans[13];
+    res[2] = trans[14];
+}
+
+static inline void GetTransMatRot(dReal res[12], const dReal trans[16]) {
+    for (i32 i = 0; i < 12; i++) {
+        res[i] = trans[i];
+    }
+}
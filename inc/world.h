@@ -0,0 +1,97 @@
+#pragma once
+
+#include "ode/ode.h"
+
+#include "util.h"
+#include "body.h"
+
+typedef enum worldStepper {
+    STEPPER_EXACT, // dWorldStep, cost grows steeply with the number of contact joints
+    STEPPER_QUICK, // dWorldQuickStep, fixed iterations so it scales linearly but stacks get soft
+    STEPPER_AUTO   // exact until a step has more than quickAbove contacts, back under exactBelow
+} WorldStepper;
+
+typedef enum worldBroadphase {
+    BROADPHASE_HASH,     // grid cells of 2^level meters, geoms bigger than the top level are tested against everything
+    BROADPHASE_SAP,      // sweep and prune, sorted along x then z
+    BROADPHASE_QUADTREE, // fixed blocks over boundsMin to boundsMax
+    BROADPHASE_SIMPLE    // every pair, only for small scenes
+} WorldBroadphase;
+
+typedef struct worldConfig {
+    WorldStepper stepper;
+    i32 quickIterations;
+    f32 quickSOR; // over relaxation for the quick step, ode's default is 1.3
+    u32 quickAbove, exactBelow;
+
+    // ode auto-disable, a body goes to sleep after sleepSteps steps under both thresholds
+    // and wakes when something awake touches it
+    u8 sleep;
+    f32 sleepLinear;  // m/s
+    f32 sleepAngular; // rad/s
+    i32 sleepSteps;
+
+    WorldBroadphase broadphase;
+    i32 hashMinLevel, hashMaxLevel;
+    // ode's quadtree splits its first two axes and assumes z is up, so in this y-up world
+    // it divides x and height. depth is how many times the root block is split
+    Vector3 boundsMin, boundsMax;
+    i32 quadDepth;
+
+    // islands are stepped on a pool of this many threads through ode's threading
+    // implementation, 1 keeps everything on the calling thread. collision is never threaded
+    i32 threads;
+} WorldConfig;
+
+#define WORLD_DEFAULT_CONFIG (WorldConfig){ .stepper = STEPPER_EXACT, .quickIterations = 20, .quickSOR = 1.3f, .quickAbove = 1500, .exactBelow = 1000, .sleep = 1, .sleepLinear = 0.05f, .sleepAngular = 0.1f, .sleepSteps = 30, .broadphase = BROADPHASE_HASH, .hashMinLevel = -3, .hashMaxLevel = 10, .boundsMin = {-64.f, -16.f, -64.f}, .boundsMax = {64.f, 112.f, 64.f}, .quadDepth = 6, .threads = 1 }
+
+typedef struct world {
+    dWorldID world;
+    dSpaceID space;       // dynamic bodies, with the configured broadphase
+    dSpaceID staticSpace; // map geometry, only ever collided against space
+    dJointGroupID contactGroup;
+
+    // NULL when stepping on one thread, including when ode was built without threading
+    dThreadingImplementationID threading;
+    dThreadingThreadPoolID pool;
+    i32 threads; // actually stepping, may be less than config.threads
+
+    Body* bodies;
+    BodyState* states;
+    i32 capacity;
+
+    // indices of everything that isn't map geometry, in the order they were added
+    i32* dynamicIDs;
+    i32 dynamicCount;
+    i32 awakeCount; // as of the last World_ExtractStates
+
+    // contact joints made by the last World_Step, and since World_Init
+    u32 stepContacts;
+    u64 totalContacts;
+    u32 stepPairs;      // pairs the broadphase passed to the near callback in the last World_Step, masks already applied
+    u32 stepNarrow;     // of those, how many had an awake body and went on to dCollide
+    f64 collideTime;    // seconds spent in dSpaceCollide in the last World_Step
+
+    WorldConfig config;
+    u8 quick;       // the last step used dWorldQuickStep
+    u64 quickSteps; // since World_Init
+} World;
+
+// dInitODE has to be called before any of these
+i8 World_Init(World* w, i32 capacity, const WorldConfig* config);
+void World_Destroy(World* w);
+
+i32 World_AddBody(World* w, CollMask category, CollMask collide, BodyState state, i8 isKinematic);
+i32 World_AddBodyMap(World* w, Vector3 pos, Vector3 rot, Vector3 size, Color col);
+void World_AddDefaultMap(World* w);
+
+void World_Step(World* w, dReal dt);
+const i8* World_StepperName(WorldStepper stepper);
+// exact, quick or auto. returns nonzero for anything else
+i8 World_ParseStepper(const i8* name, WorldStepper* stepper);
+const i8* World_BroadphaseName(WorldBroadphase broadphase);
+// hash, sap, quadtree or simple. returns nonzero for anything else
+i8 World_ParseBroadphase(const i8* name, WorldBroadphase* broadphase);
+// only touches dynamic bodies, and only copies the transform out of awake ones
+// plus the ones that fell asleep since the last call, so they settle where they stopped
+void World_ExtractStates(World* w);
@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../inc/aoi.h"
+
+static i32 CellCoord(f32 v, f32 min, f32 cellSize, i32 count) {
+    const i32 c = (i32)floorf((v - min) / cellSize);
+    return c < 0 ? 0 : c >= count ? count - 1 : c;
+}
+
+static i32 CompareIDs(const void* a, const void* b) {
+    return *(const i32*)a - *(const i32*)b;
+}
+
+i8 Aoi_GridInit(AoiGrid* g, i32 capacity, QuantBounds bounds, f32 cellSize) {
+    g->cellSize = cellSize;
+    g->minX = bounds.min.x;
+    g->minZ = bounds.min.z;
+    g->width = (i32)ceilf((bounds.max.x - bounds.min.x) / cellSize);
+    g->height = (i32)ceilf((bounds.max.z - bounds.min.z) / cellSize);
+    if (g->width < 1) g->width = 1;
+    if (g->height < 1) g->height = 1;
+    g->capacity = capacity;
+
+    g->cellStart = calloc(g->width * g->height + 1, sizeof(i32));
+    g->cellBodies = malloc(sizeof(i32) * capacity);
+    if (!g->cellStart || !g->cellBodies) {
+        Aoi_GridFree(g);
+        return 1;
+    }
+    return 0;
+}
+
+void Aoi_GridFree(AoiGrid* g) {
+    free(g->cellStart);
+    free(g->cellBodies);
+    g->cellStart = NULL;
+    g->cellBodies = NULL;
+}
+
+void Aoi_GridBuild(AoiGrid* g, const BodyState* states, const i32* ids, i32 count) {
+    const i32 cells = g->width * g->height;
+    memset(g->cellStart, 0, sizeof(i32) * (cells + 1));
+
+    // counting sort, cellStart[c + 1] counts cell c first then becomes its end
+    for (i32 n = 0; n < count; n++) {
+        const BodyState* s = &states[ids[n]];
+        if (BODYTYPE_NULL == s->type) {
+            continue;
+        }
+        const i32 cx = CellCoord(s->transform[12], g->minX, g->cellSize, g->width);
+        const i32 cz = CellCoord(s->transform[14], g->minZ, g->cellSize, g->height);
+        g->cellStart[cz * g->width + cx + 1]++;
+    }
+    for (i32 c = 0; c < cells; c++) {
+        g->cellStart[c + 1] += g->cellStart[c];
+    }
+
+    for (i32 n = 0; n < count; n++) {
+        const BodyState* s = &states[ids[n]];
+        if (BODYTYPE_NULL == s->type) {
+            continue;
+        }
+        const i32 cx = CellCoord(s->transform[12], g->minX, g->cellSize, g->width);
+        const i32 cz = CellCoord(s->transform[14], g->minZ, g->cellSize, g->height);
+        g->cellBodies[g->cellStart[cz * g->width + cx]++] = ids[n];
+    }
+
+    // the fill pass left each start at the next cell's start, shift them back
+    for (i32 c = cells; c > 0; c--) {
+        g->cellStart[c] = g->cellStart[c - 1];
+    }
+    g->cellStart[0] = 0;
+}
+
+i8 Aoi_ClientInit(AoiClient* c, i32 capacity) {
+    c->ids = malloc(sizeof(i32) * capacity);
+    c->next = malloc(sizeof(i32) * capacity);
+    c->inView = calloc(capacity, 1);
+    c->count = 0;
+    c->capacity = capacity;
+    if (!c->ids || !c->next || !c->inView) {
+        Aoi_ClientFree(c);
+        return 1;
+    }
+    return 0;
+}
+
+void Aoi_ClientFree(AoiClient* c) {
+    free(c->ids);
+    free(c->next);
+    free(c->inView);
+    c->ids = NULL;
+    c->next = NULL;
+    c->inView = NULL;
+}
+
+void Aoi_ClientUpdate(AoiClient* c, const AoiGrid* g, const BodyState* states, Vector3 pos, f32 radius) {
+    const f32 enter2 = radius * radius;
+    const f32 leave2 = enter2 * AOI_HYSTERESIS * AOI_HYSTERESIS;
+    i32 x0 = 0, x1 = g->width - 1, z0 = 0, z1 = g->height - 1;
+    if (radius > 0.f) {
+        const f32 r = radius * AOI_HYSTERESIS;
+        x0 = CellCoord(pos.x - r, g->minX, g->cellSize, g->width);
+        x1 = CellCoord(pos.x + r, g->minX, g->cellSize, g->width);
+        z0 = CellCoord(pos.z - r, g->minZ, g->cellSize, g->height);
+        z1 = CellCoord(pos.z + r, g->minZ, g->cellSize, g->height);
+    }
+
+    i32 count = 0;
+    for (i32 cz = z0; cz <= z1; cz++) {
+        for (i32 cx = x0; cx <= x1; cx++) {
+            const i32 cell = cz * g->width + cx;
+            for (i32 n = g->cellStart[cell]; n < g->cellStart[cell + 1]; n++) {
+                const i32 id = g->cellBodies[n];
+                if (radius > 0.f) {
+                    const f32 dx = states[id].transform[12] - pos.x;
+                    const f32 dy = states[id].transform[13] - pos.y;
+                    const f32 dz = states[id].transform[14] - pos.z;
+                    const f32 d2 = dx * dx + dy * dy + dz * dz;
+                    if (d2 > (c->inView[id] ? leave2 : enter2)) {
+                        continue;
+                    }
+                }
+                c->next[count++] = id;
+            }
+        }
+    }
+
+    for (i32 n = 0; n < c->count; n++) {
+        c->inView[c->ids[n]] = 0;
+    }
+    for (i32 n = 0; n < count; n++) {
+        c->inView[c->next[n]] = 1;
+    }
+    i32* ids = c->ids;
+    c->ids = c->next;
+    c->next = ids;
+    c->count = count;
+
+    // snapshots merge this against the previous frame by id
+    qsort(c->ids, count, sizeof(i32), CompareIDs);
+}
@@ -0,0 +1,764 @@
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ode/ode.h"
+#include "enet/enet.h"
+
+#include "../inc/arena.h"
+#include "../inc/log.h"
+#include "../inc/msgs.h"
+#include "../inc/move.h"
+#include "../inc/prof.h"
+#include "../inc/ring.h"
+#include "../inc/snapshot.h"
+#include "../inc/aoi.h"
+#include "../inc/telemetry.h"
+#include "../inc/tick.h"
+#include "../inc/world.h"
+
+#ifdef _WIN32
+    #include <arpa/inet.h>
+    #include <ifaddrs.h>
+#endif
+
+// plus a few per player, every broadcast queues a snapshot for each of them
+#define CMD_RING_SIZE 1024
+#define OUT_RING_SIZE 256
+#define RING_SIZE_PER_PLAYER 4
+
+// inputs a player can bank, enough to absorb a clump of late packets but
+// not enough to move noticeably faster than real time
+#define INPUT_BURST 30.f
+
+// every player is resent this often so a lost update doesn't leave anyone stale for good
+#define PLAYER_REFRESH_TIME 1.0
+
+// decoded client messages handed from the network thread to the simulation
+typedef enum netCmdType {
+    NETCMD_CONNECT,
+    NETCMD_DISCONNECT,
+    NETCMD_PLAYER_INPUT,
+    NETCMD_NEW_BODY,
+    NETCMD_SNAPSHOT_ACK
+} NetCmdType;
+
+typedef struct netCmd {
+    NetCmdType type;
+    i32 playerID;
+    union {
+        u32 connectID;
+        MsgPlayerInput input;
+        BodyState body;
+        u32 seq;
+    };
+} NetCmd;
+
+// packets handed from the simulation to the network thread
+typedef struct netOut {
+    ENetPacket* packet; // NULL to disconnect the player instead
+    i32 playerID;  // -1 to broadcast
+    u32 connectID; // so a packet meant for a player that left doesn't go to whoever got their slot
+    u8 channel;
+} NetOut;
+
+typedef struct arena {
+    QuantBounds bounds;
+    f32 interestRadius;
+    f32 tickTime;
+    size_t snapshotBudget;
+    i32 snapshotHistory;
+
+    i32 maxPlayers;
+
+    // owned by the network thread. a connected peer's data is its slot + 1, so 0 means none
+    ENetHost* host;
+    ENetPeer** peers;  // by slot
+    i32* freeSlots;    // stack of unused slots
+    i32 freeCount;
+    pthread_t netThread;
+    atomic_int netStop;
+    Telemetry telemetry;
+    u64 sampledTick;
+
+    // simulation -> network, the network thread samples telemetry once for every tick
+    _Atomic u64 simTick;
+    // network -> simulation, from the telemetry sample
+    atomic_int worstPeer;
+    atomic_uint worstRtt, worstLoss;
+
+    Ring cmdRing; // network -> simulation
+    Ring outRing; // simulation -> network
+
+    // owned by the simulation thread, everything per player has maxPlayers entries
+    World world;
+    PlayerState* players;
+    f32* inputCredit; // inputs each player may still apply, refilled at one per MOVE_DT
+    u32* connectIDs;
+    u32* dirtyPlayers;  // changed since the last MsgUpdatePlayers
+    u32* joinedPlayers; // connected since then, they get a full one of their own
+    u64 lastFullUpdate; // tick
+    MsgUpdatePlayers playerMsg;
+    u8* playerBuf;
+    size_t playerBufSize;
+
+    SnapSource snapSource;
+    AoiGrid aoiGrid;
+    AoiClient* aoiClients;
+    SnapClient* snapClients;
+    u8* snapBuf;
+    size_t snapBufSize;
+
+    // the static map, encoded once at startup and sent to everyone who joins
+    u8* levelMsg;
+    size_t levelMsgSize;
+
+    ArenaStats stats;
+} Arena;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+// connects and disconnects can't be dropped without the two threads disagreeing
+// about who is in which slot, so wait for room instead, they're rare anyway
+static void PushCmdBlocking(Arena* a, const NetCmd* cmd) {
+    while (!Ring_Push(&a->cmdRing, cmd)) {
+        if (atomic_load(&a->netStop)) {
+            return;
+        }
+        Tick_SleepUntil(Tick_Now() + 0.0005);
+    }
+}
+
+static void NetHandleConnect(Arena* a, ENetPeer* peer, u32 version) {
+    Log_Write(LOGLEVEL_INFO, "connect", "peer=%x:%u version=%u", peer->address.host, peer->address.port, version);
+    if (PROTOCOL_VERSION != version) {
+        enet_peer_disconnect(peer, DISCONNECT_VERSION);
+        Log_Write(LOGLEVEL_WARN, "bad_version", "peer=%x:%u version=%u want=%u", peer->address.host, peer->address.port, version, PROTOCOL_VERSION);
+        return;
+    }
+
+    if (0 == a->freeCount) {
+        enet_peer_disconnect(peer, DISCONNECT_FULL);
+        Log_Write(LOGLEVEL_WARN, "server_full", "peer=%x:%u", peer->address.host, peer->address.port);
+        return;
+    }
+
+    const i32 i = a->freeSlots[--a->freeCount];
+    a->peers[i] = peer;
+    peer->data = (void*)(intptr_t)(i + 1);
+    Telemetry_ResetPeer(&a->telemetry, i);
+
+    u8 buf[MSG_MAX_SIZE];
+    const size_t len = Msg_WritePlayerID(buf, sizeof(buf), &(MsgPlayerID){ .playerID = i, .maxPlayers = a->maxPlayers, .bounds = a->bounds, .tickTime = a->tickTime, .snapshotHistory = a->snapshotHistory });
+    enet_peer_send(peer, CHANNEL_RELIABLE, enet_packet_create(buf, len, ENET_PACKET_FLAG_RELIABLE));
+    Telemetry_CountSent(&a->telemetry, i, CHANNEL_RELIABLE, buf, len);
+
+    Log_Write(LOGLEVEL_INFO, "assign_id", "peer=%x:%u id=%d", peer->address.host, peer->address.port, i);
+    PushCmdBlocking(a, &(NetCmd){ .type = NETCMD_CONNECT, .playerID = i, .connectID = peer->connectID });
+}
+
+static i32 NetFindPlayer(const ENetPeer* peer) {
+    return (i32)(intptr_t)peer->data - 1;
+}
+
+static void NetHandleReceive(Arena* a, const ENetEvent* event) {
+    const u8* data = event->packet->data;
+    const size_t len = event->packet->dataLength;
+    Telemetry_CountReceived(&a->telemetry, NetFindPlayer(event->peer), event->channelID, data, len);
+
+    NetCmd cmd;
+    i8 malformed = 0;
+    switch (Msg_Type(data, len)) {
+        case MSGTYPE_S_PLAYER_INPUT: {
+            // the slot comes from the peer, not from anything in the message
+            malformed = Msg_ReadPlayerInput(data, len, &cmd.input);
+            cmd.type = NETCMD_PLAYER_INPUT;
+            cmd.playerID = NetFindPlayer(event->peer);
+        } break;
+        case MSGTYPE_S_NEW_BODY: {
+            MsgNewBody msg;
+            malformed = Msg_ReadNewBody(data, len, &a->bounds, &msg);
+            cmd.type = NETCMD_NEW_BODY;
+            cmd.playerID = NetFindPlayer(event->peer);
+            cmd.body = msg.body;
+        } break;
+        case MSGTYPE_S_SNAPSHOT_ACK: {
+            MsgSnapshotAck msg;
+            malformed = Msg_ReadSnapshotAck(data, len, &msg);
+            cmd.type = NETCMD_SNAPSHOT_ACK;
+            cmd.playerID = NetFindPlayer(event->peer);
+            cmd.seq = msg.seq;
+        } break;
+        default: {
+            Log_Write(LOGLEVEL_WARN, "unknown_msg", "channel=%u len=%zu", event->channelID, len);
+        } return;
+    }
+
+    if (malformed) {
+        Log_Write(LOGLEVEL_WARN, "malformed_msg", "type=%d channel=%u len=%zu", Msg_Type(data, len), event->channelID, len);
+        return;
+    }
+    if (-1 == cmd.playerID) {
+        return;
+    }
+
+    if (!Ring_Push(&a->cmdRing, &cmd)) {
+        Log_Write(LOGLEVEL_DEBUG, "cmd_dropped", "type=%d", cmd.type);
+    }
+}
+
+static void NetHandleDisconnect(Arena* a, ENetPeer* peer) {
+    const i32 i = NetFindPlayer(peer);
+    if (-1 == i) {
+        return;
+    }
+
+    a->peers[i] = NULL;
+    peer->data = NULL;
+    a->freeSlots[a->freeCount++] = i;
+    Log_Write(LOGLEVEL_INFO, "disconnect", "id=%d", i);
+    PushCmdBlocking(a, &(NetCmd){ .type = NETCMD_DISCONNECT, .playerID = i });
+}
+
+static void NetSend(Arena* a, const NetOut* out) {
+    if (!out->packet) {
+        // the slot is given back when enet reports the disconnect
+        ENetPeer* peer = a->peers[out->playerID];
+        if (peer && peer->connectID == out->connectID) {
+            enet_peer_disconnect(peer, DISCONNECT_SERVER_ERROR);
+        }
+        return;
+    }
+
+    const u8* data = out->packet->data;
+    const size_t len = out->packet->dataLength;
+    if (-1 == out->playerID) {
+        for (i32 i = 0; i < a->maxPlayers; i++) {
+            if (a->peers[i]) {
+                Telemetry_CountSent(&a->telemetry, i, out->channel, data, len);
+            }
+        }
+        enet_host_broadcast(a->host, out->channel, out->packet);
+        return;
+    }
+
+    ENetPeer* peer = a->peers[out->playerID];
+    if (!peer || peer->connectID != out->connectID) {
+        enet_packet_destroy(out->packet);
+        return;
+    }
+    Telemetry_CountSent(&a->telemetry, out->playerID, out->channel, data, len);
+    if (enet_peer_send(peer, out->channel, out->packet) != 0) {
+        enet_packet_destroy(out->packet);
+    }
+}
+
+static void NetSample(Arena* a) {
+    const u64 tick = atomic_load_explicit(&a->simTick, memory_order_relaxed);
+    if (tick == a->sampledTick) {
+        return;
+    }
+    a->sampledTick = tick;
+
+    Telemetry* t = &a->telemetry;
+    Telemetry_Sample(t, tick, a->peers, Tick_Now());
+    atomic_store_explicit(&a->worstPeer, t->worstPeer, memory_order_relaxed);
+    atomic_store_explicit(&a->worstRtt, t->worstRtt, memory_order_relaxed);
+    atomic_store_explicit(&a->worstLoss, t->worstLoss, memory_order_relaxed);
+}
+
+static void* NetThread(void* arg) {
+    Arena* a = arg;
+
+    while (!atomic_load(&a->netStop)) {
+        NetOut out;
+        while (Ring_Pop(&a->outRing, &out)) {
+            NetSend(a, &out);
+        }
+
+        ENetEvent event;
+        u32 timeoutMs = 1;
+        while (enet_host_service(a->host, &event, timeoutMs) > 0) {
+            switch (event.type) {
+                case ENET_EVENT_TYPE_CONNECT: {
+                    NetHandleConnect(a, event.peer, event.data);
+                } break;
+                case ENET_EVENT_TYPE_RECEIVE: {
+                    NetHandleReceive(a, &event);
+                    enet_packet_destroy(event.packet);
+                } break;
+                case ENET_EVENT_TYPE_DISCONNECT: {
+                    NetHandleDisconnect(a, event.peer);
+                } break;
+                default: {
+                    Log_Write(LOGLEVEL_WARN, "unknown_event", "type=%d", event.type);
+                } break;
+            }
+            timeoutMs = 0;
+        }
+        NetSample(a);
+    }
+
+    NetOut out;
+    while (Ring_Pop(&a->outRing, &out)) {
+        if (out.packet) {
+            enet_packet_destroy(out.packet);
+        }
+    }
+    return NULL;
+}
+
+static void Send(Arena* a, ENetPacket* packet, i32 playerID, u8 channel);
+
+// the network thread already gave the peer a slot and its id, so a player the simulation
+// can't take has to be dropped over there or the slot stays taken by someone who never plays
+static void RejectPlayer(Arena* a, i32 playerID, u32 connectID) {
+    const NetOut out = { .packet = NULL, .playerID = playerID, .connectID = connectID };
+    while (!Ring_Push(&a->outRing, &out)) {
+        if (atomic_load(&a->netStop)) {
+            return;
+        }
+        Tick_SleepUntil(Tick_Now() + 0.0005);
+    }
+}
+
+static void DrainCommands(Arena* a) {
+    NetCmd cmd;
+    while (Ring_Pop(&a->cmdRing, &cmd)) {
+        switch (cmd.type) {
+            case NETCMD_CONNECT: {
+                if (Snapshot_ClientInit(&a->snapClients[cmd.playerID], a->world.capacity, a->snapshotHistory, a->snapshotBudget) != 0) {
+                    Log_Write(LOGLEVEL_ERROR, "snapshot_alloc", "id=%d", cmd.playerID);
+                    RejectPlayer(a, cmd.playerID, cmd.connectID);
+                    break;
+                }
+                if (Aoi_ClientInit(&a->aoiClients[cmd.playerID], a->world.capacity) != 0) {
+                    Log_Write(LOGLEVEL_ERROR, "aoi_alloc", "id=%d", cmd.playerID);
+                    Snapshot_ClientFree(&a->snapClients[cmd.playerID]);
+                    RejectPlayer(a, cmd.playerID, cmd.connectID);
+                    break;
+                }
+                a->players[cmd.playerID].id = cmd.playerID;
+                a->connectIDs[cmd.playerID] = cmd.connectID;
+                Send(a, enet_packet_create(a->levelMsg, a->levelMsgSize, ENET_PACKET_FLAG_RELIABLE), cmd.playerID, CHANNEL_RELIABLE);
+                Move_Spawn(&a->players[cmd.playerID]);
+                a->inputCredit[cmd.playerID] = 0.f;
+                PLAYER_MASK_SET(a->dirtyPlayers, cmd.playerID);
+                PLAYER_MASK_SET(a->joinedPlayers, cmd.playerID);
+                a->stats.players++;
+            } break;
+            case NETCMD_DISCONNECT: {
+                if (-1 == a->players[cmd.playerID].id) {
+                    break;
+                }
+                Snapshot_ClientFree(&a->snapClients[cmd.playerID]);
+                Aoi_ClientFree(&a->aoiClients[cmd.playerID]);
+                a->players[cmd.playerID].id = -1;
+                PLAYER_MASK_SET(a->dirtyPlayers, cmd.playerID);
+                a->stats.players--;
+            } break;
+            case NETCMD_PLAYER_INPUT: {
+                PlayerState* p = &a->players[cmd.playerID];
+                if (-1 == p->id) {
+                    break;
+                }
+                for (i32 i = 0; i < cmd.input.count; i++) {
+                    const PlayerInput* in = &cmd.input.inputs[i];
+                    // inputs that were lost in between are skipped, the client gets corrected
+                    if (in->seq <= p->lastInput) {
+                        continue;
+                    }
+                    if (a->inputCredit[cmd.playerID] < 1.f) {
+                        Log_Write(LOGLEVEL_DEBUG, "input_throttled", "id=%d seq=%u", cmd.playerID, in->seq);
+                        break;
+                    }
+                    a->inputCredit[cmd.playerID] -= 1.f;
+                    Move_Simulate(p, in);
+                    p->lastInput = in->seq;
+                    PLAYER_MASK_SET(a->dirtyPlayers, cmd.playerID);
+                }
+            } break;
+            case NETCMD_NEW_BODY: {
+                if (-1 == a->players[cmd.playerID].id) {
+                    break;
+                }
+                const i32 id = World_AddBody(&a->world, CMASK_OBJ, CMASK_OBJ | CMASK_MAP, cmd.body, 0);
+                if (-1 == id) {
+                    Log_Write(LOGLEVEL_WARN, "body_rejected", "type=%d", cmd.body.type);
+                } else {
+                    a->stats.bodies++;
+                    Log_Write(LOGLEVEL_DEBUG, "new_body", "id=%d type=%d", id, cmd.body.type);
+                }
+            } break;
+            case NETCMD_SNAPSHOT_ACK: {
+                if (-1 != a->players[cmd.playerID].id) {
+                    Snapshot_ClientAck(&a->snapClients[cmd.playerID], cmd.seq);
+                }
+            } break;
+        }
+    }
+}
+
+static void RefillInputCredit(Arena* a, f32 elapsed) {
+    for (i32 i = 0; i < a->maxPlayers; i++) {
+        a->inputCredit[i] = fminf(a->inputCredit[i] + elapsed / MOVE_DT, INPUT_BURST);
+    }
+}
+
+static void Send(Arena* a, ENetPacket* packet, i32 playerID, u8 channel) {
+    const NetOut out = { .packet = packet, .playerID = playerID, .connectID = -1 == playerID ? 0 : a->connectIDs[playerID], .channel = channel };
+    if (!Ring_Push(&a->outRing, &out)) {
+        enet_packet_destroy(packet);
+    }
+}
+
+static u8 MaskEmpty(const u32* mask, i32 maxPlayers) {
+    for (i32 i = 0; i < PLAYER_MASK_WORDS(maxPlayers); i++) {
+        if (mask[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// TODO make players special bodies instead of floating cameras
+static void BroadcastPlayers(Arena* a) {
+    const u8 full = a->stats.ticks - a->lastFullUpdate >= (u64)(PLAYER_REFRESH_TIME / a->tickTime);
+    const u8 anyDirty = !MaskEmpty(a->dirtyPlayers, a->maxPlayers);
+    const u8 anyJoined = !MaskEmpty(a->joinedPlayers, a->maxPlayers);
+    if (!full && !anyDirty && !anyJoined) {
+        return;
+    }
+
+    // with a lot of players a full update goes past the mtu, so it has to be allowed to fragment
+    MsgUpdatePlayers* msg = &a->playerMsg;
+    if (full || anyDirty) {
+        Msg_CollectPlayers(msg, a->players, a->dirtyPlayers, full);
+        const size_t len = Msg_WriteUpdatePlayers(a->playerBuf, a->playerBufSize, msg);
+        Send(a, enet_packet_create(a->playerBuf, len, ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT), -1, CHANNEL_STATE);
+    }
+
+    // anyone who just joined missed everything before, the broadcast above only has what changed
+    if (!full && anyJoined) {
+        Msg_CollectPlayers(msg, a->players, a->dirtyPlayers, 1);
+        const size_t len = Msg_WriteUpdatePlayers(a->playerBuf, a->playerBufSize, msg);
+        for (i32 i = 0; i < a->maxPlayers; i++) {
+            if (PLAYER_MASK_HAS(a->joinedPlayers, i) && -1 != a->players[i].id) {
+                Send(a, enet_packet_create(a->playerBuf, len, ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT), i, CHANNEL_STATE);
+            }
+        }
+    }
+
+    if (full) {
+        u8 buf[MSG_MAX_SIZE];
+        const size_t len = Msg_WriteServerStats(buf, sizeof(buf), &(MsgServerStats){
+            .tick = (u32)a->stats.ticks,
+            .overruns = (u32)a->stats.overruns,
+            .droppedTicks = (u32)a->stats.droppedTicks
+        });
+        Send(a, enet_packet_create(buf, len, 0), -1, CHANNEL_STATE);
+        a->lastFullUpdate = a->stats.ticks;
+    }
+    memset(a->dirtyPlayers, 0, sizeof(u32) * PLAYER_MASK_WORDS(a->maxPlayers));
+    memset(a->joinedPlayers, 0, sizeof(u32) * PLAYER_MASK_WORDS(a->maxPlayers));
+}
+
+static void Broadcast(Arena* a) {
+    World_ExtractStates(&a->world);
+    a->stats.awakeBodies = a->world.awakeCount;
+    PROF_BEGIN(PROF_BROADCAST);
+    // quantize once here rather than once per client in Snapshot_Encode
+    Snapshot_SourceUpdate(&a->snapSource, a->world.states, a->world.dynamicIDs, a->world.dynamicCount, (u32)a->stats.ticks);
+    Aoi_GridBuild(&a->aoiGrid, a->world.states, a->world.dynamicIDs, a->world.dynamicCount);
+
+    u64 bytes = 0;
+    u32 interest = 0, deferred = 0;
+    for (i32 i = 0; i < a->maxPlayers; i++) {
+        if (-1 == a->players[i].id) {
+            continue;
+        }
+
+        AoiClient* aoi = &a->aoiClients[i];
+        Aoi_ClientUpdate(aoi, &a->aoiGrid, a->world.states, a->players[i].pos, a->interestRadius);
+        interest += aoi->count;
+
+        const size_t len = Snapshot_Encode(&a->snapClients[i], &a->snapSource, aoi->ids, aoi->count, a->players[i].pos, a->snapBuf, a->snapBufSize);
+        deferred += a->snapClients[i].deferred;
+        // without UNRELIABLE_FRAGMENT enet would send big snapshots reliably
+        Send(a, enet_packet_create(a->snapBuf, len, ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT), i, CHANNEL_STATE);
+        bytes += len;
+    }
+    a->stats.snapshotBytes = bytes;
+    a->stats.interestBodies = interest;
+    a->stats.deferredBodies = deferred;
+    a->stats.snapshotBytesTotal += bytes;
+
+    BroadcastPlayers(a);
+    PROF_END(PROF_BROADCAST);
+}
+
+static void UpdateQueueStats(Arena* a) {
+    a->stats.cmdQueueDepth = Ring_Depth(&a->cmdRing);
+    a->stats.cmdQueuePeak = atomic_load_explicit(&a->cmdRing.peakDepth, memory_order_relaxed);
+    a->stats.cmdOverflows = atomic_load_explicit(&a->cmdRing.overflows, memory_order_relaxed);
+    a->stats.outQueueDepth = Ring_Depth(&a->outRing);
+    a->stats.outQueuePeak = atomic_load_explicit(&a->outRing.peakDepth, memory_order_relaxed);
+    a->stats.outOverflows = atomic_load_explicit(&a->outRing.overflows, memory_order_relaxed);
+    a->stats.worstPeer = atomic_load_explicit(&a->worstPeer, memory_order_relaxed);
+    a->stats.worstRtt = atomic_load_explicit(&a->worstRtt, memory_order_relaxed);
+    a->stats.worstLoss = atomic_load_explicit(&a->worstLoss, memory_order_relaxed) / (f32)ENET_PEER_PACKET_LOSS_SCALE;
+}
+
+static void FreePlayers(Arena* a) {
+    free(a->peers);
+    free(a->freeSlots);
+    free(a->players);
+    free(a->inputCredit);
+    free(a->connectIDs);
+    free(a->dirtyPlayers);
+    free(a->joinedPlayers);
+    free(a->aoiClients);
+    free(a->snapClients);
+    free(a->playerMsg.slots);
+    free(a->playerMsg.players);
+    free(a->playerBuf);
+}
+
+static i8 AllocPlayers(Arena* a, i32 maxPlayers) {
+    a->maxPlayers = maxPlayers;
+    a->peers = calloc(maxPlayers, sizeof(ENetPeer*));
+    a->freeSlots = malloc(sizeof(i32) * maxPlayers);
+    a->players = malloc(sizeof(PlayerState) * maxPlayers);
+    a->inputCredit = calloc(maxPlayers, sizeof(f32));
+    a->connectIDs = calloc(maxPlayers, sizeof(u32));
+    a->dirtyPlayers = calloc(PLAYER_MASK_WORDS(maxPlayers), sizeof(u32));
+    a->joinedPlayers = calloc(PLAYER_MASK_WORDS(maxPlayers), sizeof(u32));
+    a->aoiClients = calloc(maxPlayers, sizeof(AoiClient));
+    a->snapClients = calloc(maxPlayers, sizeof(SnapClient));
+    a->playerMsg.capacity = maxPlayers;
+    a->playerMsg.slots = malloc(sizeof(i32) * maxPlayers);
+    a->playerMsg.players = malloc(sizeof(PlayerState) * maxPlayers);
+    a->playerBufSize = Msg_UpdatePlayersMaxSize(maxPlayers);
+    a->playerBuf = malloc(a->playerBufSize);
+    if (!a->peers || !a->freeSlots || !a->players || !a->inputCredit || !a->connectIDs || !a->dirtyPlayers || !a->joinedPlayers ||
+        !a->aoiClients || !a->snapClients || !a->playerMsg.slots || !a->playerMsg.players || !a->playerBuf) {
+        FreePlayers(a);
+        return 1;
+    }
+
+    // a stack so slots are handed out lowest first
+    for (i32 i = 0; i < maxPlayers; i++) {
+        a->players[i].id = -1;
+        a->freeSlots[i] = maxPlayers - 1 - i;
+    }
+    a->freeCount = maxPlayers;
+    return 0;
+}
+
+static void LogAddresses(void) {
+#ifdef _WIN32
+    struct ifaddrs* interfaces;
+    if (getifaddrs(&interfaces) == 0) {
+        for (struct ifaddrs* ifa = interfaces; ifa != NULL; ifa = ifa->ifa_next) {
+            if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET) { // Only IPv4 addresses
+                char ip[INET_ADDRSTRLEN];
+                struct sockaddr_in* sockAddr = (struct sockaddr_in*)ifa->ifa_addr;
+                inet_ntop(AF_INET, &sockAddr->sin_addr, ip, INET_ADDRSTRLEN);
+                Log_Write(LOGLEVEL_INFO, "address", "ip=%s iface=%s", ip, ifa->ifa_name);
+            }
+        }
+        freeifaddrs(interfaces);
+    } else {
+        Log_Write(LOGLEVEL_WARN, "address", "error=getifaddrs");
+    }
+#endif
+}
+
+i8 Arena_Run(const ArenaConfig* config, ArenaFrameFn onFrame, void* user) {
+    if (enet_initialize() != 0) {
+        Log_Write(LOGLEVEL_ERROR, "startup", "error=enet_initialize");
+        return 1;
+    }
+
+    atexit(enet_deinitialize);
+
+    // big enough that it shouldn't go on the stack
+    Arena* a = calloc(1, sizeof(Arena));
+    if (!a) {
+        Log_Write(LOGLEVEL_ERROR, "startup", "error=alloc");
+        return 1;
+    }
+
+    a->bounds = config->bounds;
+    a->interestRadius = config->interestRadius;
+    a->tickTime = 1.0 / config->tickRate;
+    a->snapshotBudget = config->snapshotBudget;
+    a->snapshotHistory = Snapshot_HistoryFor(config->snapshotMaxRtt, config->broadcastRate);
+    const u32 ringPlayers = RING_SIZE_PER_PLAYER * config->maxPlayers;
+    if (AllocPlayers(a, config->maxPlayers) != 0) {
+        Log_Write(LOGLEVEL_ERROR, "startup", "error=alloc");
+        free(a);
+        return 1;
+    }
+    if (Ring_Init(&a->cmdRing, sizeof(NetCmd), CMD_RING_SIZE + ringPlayers) != 0 || Ring_Init(&a->outRing, sizeof(NetOut), OUT_RING_SIZE + ringPlayers) != 0) {
+        Log_Write(LOGLEVEL_ERROR, "startup", "error=ring_init");
+        Ring_Free(&a->cmdRing);
+        FreePlayers(a);
+        free(a);
+        return 1;
+    }
+
+    const ENetAddress address = { .host = ENET_HOST_ANY, .port = config->port };
+    a->host = enet_host_create(&address, config->maxPlayers, CHANNEL_COUNT, 0, 0);
+    if (!a->host) {
+        Log_Write(LOGLEVEL_ERROR, "startup", "error=enet_host_create port=%u", config->port);
+        Ring_Free(&a->cmdRing);
+        Ring_Free(&a->outRing);
+        FreePlayers(a);
+        free(a);
+        return 1;
+    }
+
+    Log_Write(LOGLEVEL_INFO, "startup", "port=%u max_players=%d max_bodies=%d tick_rate=%.1f broadcast_rate=%.1f snapshot_history=%d stepper=%s quick_iterations=%d quick_sor=%.2f sleep=%d broadphase=%s physics_threads=%d", a->host->address.port, a->maxPlayers, MAX_BODIES, config->tickRate, config->broadcastRate, a->snapshotHistory, World_StepperName(config->physics.stepper), config->physics.quickIterations, config->physics.quickSOR, config->physics.sleep, World_BroadphaseName(config->physics.broadphase), config->physics.threads);
+    LogAddresses();
+
+    // a quadtree covers the same box positions are quantized in
+    WorldConfig physics = config->physics;
+    physics.boundsMin = a->bounds.min;
+    physics.boundsMax = a->bounds.max;
+    dInitODE();
+    if (World_Init(&a->world, MAX_BODIES, &physics) != 0) {
+        Log_Write(LOGLEVEL_ERROR, "startup", "error=world_init");
+        enet_host_destroy(a->host);
+        Ring_Free(&a->cmdRing);
+        Ring_Free(&a->outRing);
+        FreePlayers(a);
+        dCloseODE();
+        free(a);
+        return 1;
+    }
+
+    if (a->world.threads != physics.threads) {
+        Log_Write(LOGLEVEL_WARN, "physics_threads", "requested=%d running=%d", physics.threads, a->world.threads);
+    }
+    World_AddDefaultMap(&a->world);
+
+    a->snapBufSize = Snapshot_MaxSize(a->world.capacity);
+    a->snapBuf = malloc(a->snapBufSize);
+    a->levelMsg = malloc(a->snapBufSize);
+    const i8 sourceFailed = Snapshot_SourceInit(&a->snapSource, a->world.capacity, a->bounds) | Aoi_GridInit(&a->aoiGrid, a->world.capacity, a->bounds, config->interestCell);
+    if (a->levelMsg) {
+        a->levelMsgSize = Snapshot_EncodeLevel(a->world.states, a->world.capacity, a->levelMsg, a->snapBufSize);
+        Log_Write(LOGLEVEL_INFO, "level", "bytes=%zu", a->levelMsgSize);
+    }
+
+    atomic_init(&a->netStop, 0);
+    atomic_init(&a->simTick, 0);
+    atomic_init(&a->worstPeer, -1);
+    atomic_init(&a->worstRtt, 0);
+    atomic_init(&a->worstLoss, 0);
+    a->stats.worstPeer = -1;
+    a->stats.quickStep = a->world.quick;
+    const i8 telemetryFailed = Telemetry_Init(&a->telemetry, config->telemetryPath, a->maxPlayers);
+    const i8 allocFailed = !a->snapBuf || !a->levelMsg || sourceFailed;
+    if (telemetryFailed || allocFailed || pthread_create(&a->netThread, NULL, NetThread, a) != 0) {
+        Log_Write(LOGLEVEL_ERROR, "startup", "error=%s", telemetryFailed ? "telemetry" : allocFailed ? "alloc" : "pthread_create");
+        if (!telemetryFailed) {
+            Telemetry_Free(&a->telemetry);
+        }
+        free(a->snapBuf);
+        free(a->levelMsg);
+        Snapshot_SourceFree(&a->snapSource);
+        Aoi_GridFree(&a->aoiGrid);
+        World_Destroy(&a->world);
+        enet_host_destroy(a->host);
+        Ring_Free(&a->cmdRing);
+        Ring_Free(&a->outRing);
+        FreePlayers(a);
+        dCloseODE();
+        free(a);
+        return 1;
+    }
+
+    TickClock clock;
+    Tick_Init(&clock, config->tickRate, config->maxCatchUp);
+    const f32 physicsTime = clock.tickTime;
+
+    i32 broadcastInterval = (i32)(config->tickRate / config->broadcastRate + 0.5);
+    if (broadcastInterval < 1) {
+        broadcastInterval = 1;
+    }
+
+    while (!stopRequested) {
+        const i32 due = Tick_Due(&clock);
+        if (0 == due) {
+            Tick_SleepUntil(clock.nextTick);
+            continue;
+        }
+
+        RefillInputCredit(a, due * physicsTime);
+        DrainCommands(a);
+        for (i32 i = 0; i < due; i++) {
+            World_Step(&a->world, physicsTime);
+        }
+        if (a->world.quick != a->stats.quickStep) {
+            Log_Write(LOGLEVEL_INFO, "stepper_switch", "tick=%llu stepper=%s contacts=%u", (unsigned long long)clock.ticks, a->world.quick ? "quick" : "exact", a->world.stepContacts);
+        }
+        a->stats.contacts = a->world.stepContacts;
+        a->stats.quickStep = a->world.quick;
+
+        const u64 lastTick = a->stats.ticks;
+        a->stats.ticks = clock.ticks;
+        atomic_store_explicit(&a->simTick, clock.ticks, memory_order_relaxed);
+        if (clock.overruns != a->stats.overruns) {
+            Log_Write(LOGLEVEL_WARN, "tick_overrun", "tick=%llu dropped=%llu", (unsigned long long)clock.ticks, (unsigned long long)(clock.droppedTicks - a->stats.droppedTicks));
+            a->stats.overruns = clock.overruns;
+            a->stats.droppedTicks = clock.droppedTicks;
+        }
+
+        if (lastTick / broadcastInterval != a->stats.ticks / broadcastInterval) {
+            Broadcast(a);
+        }
+
+        UpdateQueueStats(a);
+        Prof_FrameEnd();
+        if (onFrame && onFrame(&a->stats, user)) {
+            break;
+        }
+    }
+
+    atomic_store(&a->netStop, 1);
+    pthread_join(a->netThread, NULL);
+    Telemetry_Free(&a->telemetry);
+
+    Log_Write(LOGLEVEL_INFO, "shutdown", "ticks=%llu overruns=%llu cmd_overflows=%u out_overflows=%u", (unsigned long long)a->stats.ticks, (unsigned long long)a->stats.overruns, a->stats.cmdOverflows, a->stats.outOverflows);
+
+    for (i32 i = 0; i < a->maxPlayers; i++) {
+        if (-1 != a->players[i].id) {
+            Snapshot_ClientFree(&a->snapClients[i]);
+            Aoi_ClientFree(&a->aoiClients[i]);
+        }
+    }
+    FreePlayers(a);
+    free(a->snapBuf);
+    free(a->levelMsg);
+    Snapshot_SourceFree(&a->snapSource);
+    Aoi_GridFree(&a->aoiGrid);
+
+    enet_host_destroy(a->host);
+    Ring_Free(&a->cmdRing);
+    Ring_Free(&a->outRing);
+    World_Destroy(&a->world);
+    dCloseODE();
+    free(a);
+    stopRequested = 0;
+    return 0;
+}
+
+void Arena_RequestStop(void) {
+    stopRequested = 1;
+}
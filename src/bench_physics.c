@@ -0,0 +1,403 @@
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/resource.h>
+#endif
+
+#include "ode/ode.h"
+
+#include "../inc/util.h"
+#include "../inc/world.h"
+#include "../inc/tick.h"
+#include "../inc/rand.h"
+#include "../inc/transform.h"
+
+// headless physics benchmark, builds worlds the same way the server does (default map,
+// World_AddBody with the server's collision masks, the same near callback) and times
+// World_Step on a few scenes. one json object per scenario goes to stdout so runs can be
+// diffed between commits:
+//   bench_physics [--scenario NAME] [--steps-scale 1] [--seed 1] [--label STR] [--list]
+//                 [--stepper exact|quick|auto] [--quick-iterations 20] [--quick-sor 1.3]
+//                 [--quick-above 1500] [--exact-below 1000] [--no-sleep] [--sleep-linear 0.05]
+//                 [--sleep-angular 0.1] [--sleep-steps 30] [--broadphase hash|sap|quadtree|simple]
+//                 [--hash-levels -3,10] [--quadtree-depth 6] [--threads 1]
+// --scenario matches any part of the name, so "rain" runs all of the rain scenes
+
+#define STEP_TIME (1.0 / 120.0) // the server's default tick
+#define BODY_SPACING 1.1        // lattice pitch, the biggest spawned body is 1 across
+
+typedef struct scenario {
+    const i8* name;
+    const i8* about;
+    i32 count;
+    i32 steps;
+    i8 (*build)(World* w, i32 count);
+} Scenario;
+
+typedef struct benchResult {
+    f64 buildMs;
+    f64 meanNs, p50Ns, p99Ns, maxNs;
+    f64 meanCollideNs, p99CollideNs;
+    f64 meanPairs, meanNarrow;
+    f64 meanContacts;
+    u32 maxContacts;
+    u64 joints;
+    u64 quickSteps;
+    i32 threads;
+    i32 awake;
+    f64 meanSpeed; // at the end, m/s
+    f64 maxDrift;  // furthest any body got from where it was built, m
+    u64 odePeak;   // bytes
+    i64 rssPeak;   // kB, -1 where getrusage isn't around
+} BenchResult;
+
+// everything ode allocates goes through these so the peak can be reported
+static atomic_ullong odeBytes = 0;
+static atomic_ullong odePeak = 0;
+
+static void TrackBytes(i64 delta) {
+    const u64 now = atomic_fetch_add(&odeBytes, (u64)delta) + (u64)delta;
+    u64 peak = atomic_load(&odePeak);
+    while (now > peak && !atomic_compare_exchange_weak(&odePeak, &peak, now)) {
+    }
+}
+
+static void* TrackedAlloc(dsizeint size) {
+    void* p = malloc(size);
+    if (p) {
+        TrackBytes((i64)size);
+    }
+    return p;
+}
+
+static void* TrackedRealloc(void* ptr, dsizeint oldSize, dsizeint newSize) {
+    void* p = realloc(ptr, newSize);
+    if (p) {
+        TrackBytes((i64)newSize - (i64)oldSize);
+    }
+    return p;
+}
+
+static void TrackedFree(void* ptr, dsizeint size) {
+    free(ptr);
+    TrackBytes(-(i64)size);
+}
+
+// a random body like the ones KEY_M spawns
+static BodyState RandomBody(void) {
+    BodyState state = { .col = Rand_Color(30, 190) };
+    if (Rand_Int(0, 2) == 0) {
+        state.type = BODYTYPE_BOX;
+        state.size = (Vector3){Rand_Double(0.2, 1.0), Rand_Double(0.2, 1.0), Rand_Double(0.2, 1.0)};
+    } else {
+        state.type = BODYTYPE_SPHERE;
+        state.size = (Vector3){Rand_Double(0.1, 0.4), 0.f, 0.f};
+    }
+    return state;
+}
+
+static i8 AddAt(World* w, BodyState state, Vector3 pos) {
+    GetTransformMatV(state.transform, pos, (Vector3){0.f, 0.f, 0.f});
+    return World_AddBody(w, CMASK_OBJ, CMASK_OBJ | CMASK_MAP, state, 0) < 0;
+}
+
+// fills layers of a square lattice from y upwards until count bodies are placed
+static i8 AddLattice(World* w, i32 count, f32 halfWidth, f32 y) {
+    const i32 side = (i32)(halfWidth * 2.f / BODY_SPACING) + 1;
+    const f32 jitter = (BODY_SPACING - 1.f) * 0.5f;
+    for (i32 n = 0; n < count; n++) {
+        const i32 cell = n % (side * side);
+        const Vector3 pos = {
+            -halfWidth + (cell % side) * BODY_SPACING + Rand_Double(-jitter, jitter),
+            y + (n / (side * side)) * BODY_SPACING,
+            -halfWidth + (cell / side) * BODY_SPACING + Rand_Double(-jitter, jitter)
+        };
+        if (AddAt(w, RandomBody(), pos) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static i8 BuildRain(World* w, i32 count) {
+    return AddLattice(w, count, 45.f, 10.f);
+}
+
+// towers of unit cubes away from the walls, 20 high
+static i8 BuildStacks(World* w, i32 count) {
+    const i32 HEIGHT = 20;
+    for (i32 n = 0; n < count; n++) {
+        const i32 tower = n / HEIGHT;
+        const Vector3 pos = {12.f + (tower % 4) * 3.f, 1.f + (n % HEIGHT) * 1.001f, -9.f + (tower / 4) * 3.f};
+        const BodyState state = { .type = BODYTYPE_BOX, .size = (Vector3){1.f, 1.f, 1.f}, .col = Rand_Color(30, 190) };
+        if (AddAt(w, state, pos) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// everything dropped at once into the corner the walls make, where KEY_M spawns.
+// starts above the top of the leaning wall
+static i8 BuildPileUp(World* w, i32 count) {
+    return AddLattice(w, count, 3.5f, 8.f);
+}
+
+// one layer resting on the floor around the walls, nothing is moving
+static i8 BuildIdle(World* w, i32 count) {
+    const f32 spacing = 1.3f;
+    const i32 side = (i32)(90.f / spacing) + 1;
+    i32 placed = 0;
+    for (i32 cell = 0; cell < side * side && placed < count; cell++) {
+        const f32 x = -45.f + (cell % side) * spacing;
+        const f32 z = -45.f + (cell / side) * spacing;
+        if (fabsf(x) < 9.f && fabsf(z) < 8.f) {
+            continue;
+        }
+        const BodyState state = RandomBody();
+        const f32 half = BODYTYPE_BOX == state.type ? state.size.y * 0.5f : state.size.x;
+        if (AddAt(w, state, (Vector3){x, 0.5f + half, z}) != 0) {
+            return 1;
+        }
+        placed++;
+    }
+    return placed < count;
+}
+
+static const Scenario scenarios[] = {
+    { "rain_512", "mixed bodies falling onto the floor", 512, 1200, BuildRain },
+    { "rain_4k", "mixed bodies falling onto the floor", 4096, 600, BuildRain },
+    { "rain_32k", "mixed bodies falling onto the floor", 32768, 240, BuildRain },
+    { "stacks", "16 towers of 20 unit cubes", 320, 1200, BuildStacks },
+    { "pen_pileup", "a heap falling into the walled corner", 512, 1800, BuildPileUp },
+    { "idle_4k", "bodies lying still on the floor", 4096, 600, BuildIdle }
+};
+#define SCENARIO_COUNT (i32)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+static i32 CompareF64(const void* a, const void* b) {
+    const f64 x = *(const f64*)a;
+    const f64 y = *(const f64*)b;
+    return (x > y) - (x < y);
+}
+
+static i64 PeakRSS(void) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (0 == getrusage(RUSAGE_SELF, &usage)) {
+    #ifdef __APPLE__
+        return usage.ru_maxrss / 1024; // bytes there
+    #else
+        return usage.ru_maxrss;
+    #endif
+    }
+#endif
+    return -1;
+}
+
+static i8 RunScenario(const Scenario* s, i32 steps, const WorldConfig* config, BenchResult* r) {
+    memset(r, 0, sizeof(*r));
+    atomic_store(&odePeak, atomic_load(&odeBytes));
+    f64* times = malloc(sizeof(f64) * steps);
+    f64* collideTimes = malloc(sizeof(f64) * steps);
+    Vector3* start = malloc(sizeof(Vector3) * s->count);
+    World w;
+    if (!times || !collideTimes || !start || World_Init(&w, s->count + 16, config) != 0) {
+        free(times);
+        free(collideTimes);
+        free(start);
+        return 1;
+    }
+
+    const f64 buildStart = Tick_Now();
+    World_AddDefaultMap(&w);
+    if (s->build(&w, s->count) != 0) {
+        fprintf(stderr, "%s: couldn't add %d bodies\n", s->name, s->count);
+        World_Destroy(&w);
+        free(times);
+        free(collideTimes);
+        free(start);
+        return 1;
+    }
+    r->buildMs = (Tick_Now() - buildStart) * 1000.0;
+
+    for (i32 n = 0; n < w.dynamicCount; n++) {
+        const dReal* p = dBodyGetPosition(w.bodies[w.dynamicIDs[n]].body);
+        start[n] = (Vector3){p[0], p[1], p[2]};
+    }
+
+    f64 contactSum = 0.0, pairSum = 0.0, narrowSum = 0.0;
+    for (i32 i = 0; i < steps; i++) {
+        const f64 t = Tick_Now();
+        World_Step(&w, STEP_TIME);
+        times[i] = (Tick_Now() - t) * 1e9;
+
+        collideTimes[i] = w.collideTime * 1e9;
+        r->meanCollideNs += collideTimes[i];
+        pairSum += w.stepPairs;
+        narrowSum += w.stepNarrow;
+        contactSum += w.stepContacts;
+        if (w.stepContacts > r->maxContacts) {
+            r->maxContacts = w.stepContacts;
+        }
+        r->meanNs += times[i];
+    }
+    r->meanNs /= steps;
+    r->meanCollideNs /= steps;
+    r->meanPairs = pairSum / steps;
+    r->meanNarrow = narrowSum / steps;
+    r->meanContacts = contactSum / steps;
+    r->joints = w.totalContacts;
+    r->quickSteps = w.quickSteps;
+    r->threads = w.threads;
+
+    qsort(times, steps, sizeof(f64), CompareF64);
+    r->p50Ns = times[steps / 2];
+    r->p99Ns = times[(i32)ceil(steps * 0.99) - 1];
+    r->maxNs = times[steps - 1];
+    qsort(collideTimes, steps, sizeof(f64), CompareF64);
+    r->p99CollideNs = collideTimes[(i32)ceil(steps * 0.99) - 1];
+
+    for (i32 n = 0; n < w.dynamicCount; n++) {
+        const dBodyID body = w.bodies[w.dynamicIDs[n]].body;
+        const dReal* p = dBodyGetPosition(body);
+        const dReal* v = dBodyGetLinearVel(body);
+        const f64 dx = p[0] - start[n].x;
+        const f64 dy = p[1] - start[n].y;
+        const f64 dz = p[2] - start[n].z;
+        const f64 drift = sqrt(dx * dx + dy * dy + dz * dz);
+        if (drift > r->maxDrift) {
+            r->maxDrift = drift;
+        }
+        r->meanSpeed += sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        r->awake += dBodyIsEnabled(body) != 0;
+    }
+    r->meanSpeed /= w.dynamicCount > 0 ? w.dynamicCount : 1;
+    r->odePeak = atomic_load(&odePeak);
+    r->rssPeak = PeakRSS();
+
+    World_Destroy(&w);
+    free(times);
+    free(collideTimes);
+    free(start);
+    return 0;
+}
+
+static void PrintUsage(const i8* exe) {
+    fprintf(stderr, "usage: %s [--scenario NAME] [--steps-scale F] [--seed N] [--label STR] [--list] [--stepper exact|quick|auto] [--quick-iterations N] [--quick-sor W] [--quick-above CONTACTS] [--exact-below CONTACTS] [--no-sleep] [--sleep-linear M/S] [--sleep-angular RAD/S] [--sleep-steps N] [--broadphase hash|sap|quadtree|simple] [--hash-levels MIN,MAX] [--quadtree-depth N] [--threads N]\n", exe);
+}
+
+i32 main(i32 argc, i8** argv) {
+    const i8* filter = NULL;
+    const i8* label = "";
+    f64 stepsScale = 1.0;
+    u32 seed = 1;
+    WorldConfig physics = WORLD_DEFAULT_CONFIG;
+
+    for (i32 i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--scenario") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (0 == strcmp(argv[i], "--steps-scale") && i + 1 < argc) {
+            stepsScale = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--label") && i + 1 < argc) {
+            label = argv[++i];
+        } else if (0 == strcmp(argv[i], "--stepper") && i + 1 < argc) {
+            if (World_ParseStepper(argv[++i], &physics.stepper) != 0) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (0 == strcmp(argv[i], "--quick-iterations") && i + 1 < argc) {
+            physics.quickIterations = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--quick-sor") && i + 1 < argc) {
+            physics.quickSOR = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--quick-above") && i + 1 < argc) {
+            physics.quickAbove = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--exact-below") && i + 1 < argc) {
+            physics.exactBelow = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--no-sleep")) {
+            physics.sleep = 0;
+        } else if (0 == strcmp(argv[i], "--sleep-linear") && i + 1 < argc) {
+            physics.sleepLinear = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--sleep-angular") && i + 1 < argc) {
+            physics.sleepAngular = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--sleep-steps") && i + 1 < argc) {
+            physics.sleepSteps = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--broadphase") && i + 1 < argc) {
+            if (World_ParseBroadphase(argv[++i], &physics.broadphase) != 0) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (0 == strcmp(argv[i], "--hash-levels") && i + 1 < argc) {
+            if (2 != sscanf(argv[++i], "%d,%d", &physics.hashMinLevel, &physics.hashMaxLevel)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (0 == strcmp(argv[i], "--quadtree-depth") && i + 1 < argc) {
+            physics.quadDepth = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--threads") && i + 1 < argc) {
+            physics.threads = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--list")) {
+            for (i32 n = 0; n < SCENARIO_COUNT; n++) {
+                printf("%-12s %6d bodies %5d steps  %s\n", scenarios[n].name, scenarios[n].count, scenarios[n].steps, scenarios[n].about);
+            }
+            return 0;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (physics.quickIterations < 1 || physics.quickSOR <= 0.f || physics.quickSOR >= 2.f || physics.exactBelow > physics.quickAbove || physics.sleepLinear < 0.f || physics.sleepAngular < 0.f || physics.sleepSteps < 1 || physics.hashMinLevel > physics.hashMaxLevel || physics.quadDepth < 1 || physics.threads < 1) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    // has to happen before ode allocates anything
+    dSetAllocHandler(TrackedAlloc);
+    dSetReallocHandler(TrackedRealloc);
+    dSetFreeHandler(TrackedFree);
+    dInitODE();
+
+    i32 ran = 0, failed = 0;
+    for (i32 n = 0; n < SCENARIO_COUNT; n++) {
+        const Scenario* s = &scenarios[n];
+        if (filter && !strstr(s->name, filter)) {
+            continue;
+        }
+
+        const i32 steps = (i32)(s->steps * stepsScale) > 0 ? (i32)(s->steps * stepsScale) : 1;
+        randState = seed; // every scenario gets the same bodies no matter which others run
+        BenchResult r;
+        ran++;
+        if (RunScenario(s, steps, &physics, &r) != 0) {
+            failed++;
+            continue;
+        }
+
+        printf("{\"bench\":\"physics\",\"label\":\"%s\",\"scenario\":\"%s\",\"bodies\":%d,\"steps\":%d,\"dt\":%.6f,\"seed\":%u,"
+            "\"stepper\":\"%s\",\"quick_iterations\":%d,\"quick_sor\":%.2f,\"quick_steps\":%llu,\"sleep\":%d,\"broadphase\":\"%s\",\"threads\":%d,"
+            "\"build_ms\":%.2f,\"ns_per_step\":%.0f,\"p50_ns\":%.0f,\"p99_ns\":%.0f,\"max_ns\":%.0f,"
+            "\"collide_ns\":%.0f,\"collide_p99_ns\":%.0f,\"pairs_per_step\":%.1f,\"narrowphase_per_step\":%.1f,"
+            "\"contacts_per_step\":%.1f,\"max_contacts\":%u,\"joints_created\":%llu,"
+            "\"awake_end\":%d,\"mean_speed_end\":%.4f,\"max_drift\":%.3f,\"ode_peak_bytes\":%llu,\"rss_peak_kb\":%lld}\n",
+            label, s->name, s->count, steps, STEP_TIME, seed,
+            World_StepperName(physics.stepper), physics.quickIterations, physics.quickSOR, (unsigned long long)r.quickSteps, physics.sleep, World_BroadphaseName(physics.broadphase), r.threads,
+            r.buildMs, r.meanNs, r.p50Ns, r.p99Ns, r.maxNs,
+            r.meanCollideNs, r.p99CollideNs, r.meanPairs, r.meanNarrow,
+            r.meanContacts, r.maxContacts, (unsigned long long)r.joints,
+            r.awake, r.meanSpeed, r.maxDrift, (unsigned long long)r.odePeak, (long long)r.rssPeak);
+        fflush(stdout);
+    }
+
+    dCloseODE();
+    if (0 == ran) {
+        fprintf(stderr, "no scenario matches \"%s\", try --list\n", filter);
+        return 1;
+    }
+    return failed != 0;
+}
@@ -0,0 +1,104 @@
+#include <math.h>
+#include <string.h>
+
+#include "../inc/bits.h"
+
+i32 Bits_Range(i32 min, i32 max) {
+    u32 span = (u32)(max - min);
+    i32 bits = 1;
+    while (span >>= 1) {
+        bits++;
+    }
+    return bits;
+}
+
+void Bits_WriterInit(BitWriter* w, u8* data, size_t size) {
+    w->data = data;
+    w->size = size;
+    w->bits = 0;
+    w->overflow = 0;
+}
+
+void Bits_Write(BitWriter* w, u32 value, i32 count) {
+    if (w->overflow || w->bits + count > w->size * 8) {
+        w->overflow = 1;
+        return;
+    }
+
+    while (count > 0) {
+        const size_t byte = w->bits >> 3;
+        const i32 offset = w->bits & 7;
+        const i32 n = 8 - offset < count ? 8 - offset : count;
+        if (0 == offset) {
+            w->data[byte] = 0;
+        }
+        w->data[byte] |= (u8)((value & ((1u << n) - 1)) << offset);
+        value = n < 32 ? value >> n : 0;
+        count -= n;
+        w->bits += n;
+    }
+}
+
+void Bits_WriteRange(BitWriter* w, i32 value, i32 min, i32 max) {
+    Bits_Write(w, (u32)(value - min), Bits_Range(min, max));
+}
+
+void Bits_WriteF32(BitWriter* w, f32 value) {
+    u32 raw;
+    memcpy(&raw, &value, 4);
+    Bits_Write(w, raw, 32);
+}
+
+size_t Bits_WriterBytes(const BitWriter* w) {
+    return (w->bits + 7) >> 3;
+}
+
+void Bits_ReaderInit(BitReader* r, const u8* data, size_t size) {
+    r->data = data;
+    r->size = size;
+    r->bits = 0;
+    r->failed = 0;
+}
+
+u32 Bits_Read(BitReader* r, i32 count) {
+    if (r->failed || r->bits + count > r->size * 8) {
+        r->failed = 1;
+        return 0;
+    }
+
+    u32 value = 0;
+    i32 shift = 0;
+    while (shift < count) {
+        const size_t byte = r->bits >> 3;
+        const i32 offset = r->bits & 7;
+        const i32 n = 8 - offset < count - shift ? 8 - offset : count - shift;
+        value |= (u32)((r->data[byte] >> offset) & ((1u << n) - 1)) << shift;
+        shift += n;
+        r->bits += n;
+    }
+    return value;
+}
+
+i32 Bits_ReadRange(BitReader* r, i32 min, i32 max) {
+    const i32 value = (i32)(Bits_Read(r, Bits_Range(min, max)) + (u32)min);
+    if (value < min || value > max) {
+        r->failed = 1;
+        return min;
+    }
+    return value;
+}
+
+f32 Bits_ReadF32(BitReader* r) {
+    const u32 raw = Bits_Read(r, 32);
+    f32 value;
+    memcpy(&value, &raw, 4);
+    if (!isfinite(value)) {
+        r->failed = 1;
+        return 0.f;
+    }
+    return value;
+}
+
+i8 Bits_ReaderDone(const BitReader* r) {
+    return !r->failed && (r->bits + 7) >> 3 == r->size;
+}
@@ -1,5 +1,6 @@
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <raylib.h>
@@ -8,9 +9,11 @@
 #include "../inc/util.h"
 #include "../inc/msgs.h"
 #include "../inc/player.h"
+#include "../inc/move.h"
 
 #define SCREEN_WIDTH 800
 #define SCREEN_HEIGHT 600
+#define PIXELS_PER_UNIT 20.f
 
 i32 main() {
     if (enet_initialize() != 0) {
@@ -18,7 +21,7 @@ i32 main() {
         return EXIT_FAILURE;
     }
 
-    ENetHost* client = enet_host_create(NULL, 1, 2, 0, 0);
+    ENetHost* client = enet_host_create(NULL, 1, CHANNEL_COUNT, 0, 0);
 
     if (client == NULL) {
         fprintf(stderr, "An error occurred while trying to create the client\n");
@@ -29,15 +32,13 @@ i32 main() {
     enet_address_set_host(&address, "127.0.0.1");
     address.port = 12345;
 
-    ENetPeer* peer = enet_host_connect(client, &address, 2, 0);
+    ENetPeer* peer = enet_host_connect(client, &address, CHANNEL_COUNT, PROTOCOL_VERSION);
     if (peer == NULL) {
         fprintf(stderr, "No available peers for initiating a connection\n");
         return EXIT_FAILURE;
     }
 
-    for (i32 i = 0; i < MAX_PLAYERS; i++) {
-        players[i].id = -1;
-    }
+    MsgUpdatePlayers updateMsg = {0};
 
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Multiplayer Game");
     SetTargetFPS(60);
@@ -47,24 +48,43 @@ i32 main() {
         while (enet_host_service(client, &event, 0) > 0) {
             switch (event.type) {
                 case ENET_EVENT_TYPE_RECEIVE: {
-                    switch (*(MsgType*)event.packet->data) {
+                    const u8* data = event.packet->data;
+                    const size_t len = event.packet->dataLength;
+                    switch (Msg_Type(data, len)) {
                         case MSGTYPE_C_PLAYER_ID: {
-                            if (localID != -1) {
+                            MsgPlayerID idMsg;
+                            if (localID != -1 || Msg_ReadPlayerID(data, len, &idMsg) != 0) {
+                                break;
+                            }
+                            players = malloc(sizeof(PlayerState) * idMsg.maxPlayers);
+                            updateMsg.slots = malloc(sizeof(i32) * idMsg.maxPlayers);
+                            updateMsg.players = malloc(sizeof(PlayerState) * idMsg.maxPlayers);
+                            if (!players || !updateMsg.slots || !updateMsg.players) {
+                                fprintf(stderr, "Couldn't allocate %d players\n", idMsg.maxPlayers);
                                 break;
                             }
-                            const MsgPlayerID* idMsg = (MsgPlayerID*)event.packet->data;
-                            const i32 id = idMsg->playerID;
+                            playerCapacity = updateMsg.capacity = idMsg.maxPlayers;
+                            for (i32 i = 0; i < playerCapacity; i++) {
+                                players[i].id = -1;
+                            }
+
+                            const i32 id = idMsg.playerID;
                             players[id].id = id;
                             localID = id;
                             printf("RECEIVED ID: %d\n", id);
                         } break;
                         case MSGTYPE_C_UPDATE_PLAYERS: {
-                            const MsgUpdatePlayers* updateMsg = (MsgUpdatePlayers*)event.packet->data;
-                            for (i32 i = 0; i < MAX_PLAYERS; i++) {
-                                if (i != localID) {
-                                    players[i] = updateMsg->players[i];
+                            if (localID == -1 || Msg_ReadUpdatePlayers(data, len, &updateMsg) != 0) {
+                                break;
+                            }
+                            if (updateMsg.full) {
+                                for (i32 i = 0; i < playerCapacity; i++) {
+                                    players[i].id = -1;
                                 }
                             }
+                            for (i32 i = 0; i < updateMsg.count; i++) {
+                                players[updateMsg.slots[i]] = updateMsg.players[i];
+                            }
                         } break;
                         default: break;
                     }
@@ -76,37 +96,39 @@ i32 main() {
             }
         }
 
+        // runs at 60fps, one input per frame and no prediction, this just draws what the server says
+        static u32 inputSeq = 0;
+        static f32 yaw = 0.f;
         if (localID != -1) {
-            PlayerState* localPlayer = &players[localID];
-
-            const f32 moveSpeed = 300.f * GetFrameTime();
-            const f32 turnSpeed = 10.f * GetFrameTime();
-
-            if (IsKeyDown(KEY_W)) localPlayer->pos.y -= moveSpeed;
-            if (IsKeyDown(KEY_S)) localPlayer->pos.y += moveSpeed;
-            if (IsKeyDown(KEY_A)) localPlayer->pos.x -= moveSpeed;
-            if (IsKeyDown(KEY_D)) localPlayer->pos.x += moveSpeed;
-
-            localPlayer->dir.x += (IsKeyDown(KEY_LEFT) ? -turnSpeed : 0.f) + (IsKeyDown(KEY_RIGHT) ? turnSpeed : 0.f);
-
-            MsgPlayerUpdate msg = { .msg = MSGTYPE_S_PLAYER_UPDATE, .player = *localPlayer };
-            ENetPacket *packet = enet_packet_create(&msg, sizeof(MsgPlayerUpdate), ENET_PACKET_FLAG_RELIABLE);
-            enet_peer_send(peer, 0, packet);
+            u16 buttons = 0;
+            if (IsKeyDown(KEY_W)) buttons |= INPUT_FORWARD;
+            if (IsKeyDown(KEY_S)) buttons |= INPUT_BACK;
+            if (IsKeyDown(KEY_A)) buttons |= INPUT_LEFT;
+            if (IsKeyDown(KEY_D)) buttons |= INPUT_RIGHT;
+            yaw += ((IsKeyDown(KEY_LEFT) ? 1.f : 0.f) - (IsKeyDown(KEY_RIGHT) ? 1.f : 0.f)) * TURN_SPEED * GetFrameTime();
+
+            const PlayerInput input = { .seq = ++inputSeq, .buttons = buttons, .yaw = Quant_PackYaw(yaw), .pitch = Quant_PackPitch(0.f, MOVE_MAX_PITCH) };
+            const MsgPlayerInput msg = { .count = 1, .inputs = { input } };
+            u8 buf[MSG_MAX_SIZE];
+            const size_t len = Msg_WritePlayerInput(buf, sizeof(buf), &msg);
+            enet_peer_send(peer, CHANNEL_STATE, enet_packet_create(buf, len, 0));
         }
 
         BeginDrawing();
         ClearBackground(RAYWHITE);
 
-        for (i32 i = 0; i < MAX_PLAYERS; i++) {
+        for (i32 i = 0; i < playerCapacity; i++) {
             if (players[i].id == -1) {
                 continue;
             }
 
-            DrawCircleV((Vector2){players[i].pos.x, players[i].pos.y}, 10, i == localID ? RED : BLUE);
+            // top down, x to the right and z up the screen
+            const Vector2 pos = { SCREEN_WIDTH / 2.f + players[i].pos.x * PIXELS_PER_UNIT, SCREEN_HEIGHT / 2.f - players[i].pos.z * PIXELS_PER_UNIT };
+            DrawCircleV(pos, 10, i == localID ? RED : BLUE);
             DrawLineEx(
-                (Vector2){players[i].pos.x, players[i].pos.y},
-                (Vector2){players[i].pos.x + cosf(players[i].dir.x) * 20,
-                            players[i].pos.y + sinf(players[i].dir.x) * 20},
+                pos,
+                (Vector2){pos.x + players[i].dir.x * 20,
+                            pos.y - players[i].dir.z * 20},
                 2, i == localID ? BLACK : BLUE
             );
         }
@@ -115,6 +137,9 @@ i32 main() {
     }
 
     CloseWindow();
+    free(players);
+    free(updateMsg.slots);
+    free(updateMsg.players);
     enet_peer_disconnect(peer, 0);
     enet_host_destroy(client);
     enet_deinitialize();
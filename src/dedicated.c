@@ -0,0 +1,136 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/util.h"
+#include "../inc/arena.h"
+#include "../inc/log.h"
+#include "../inc/prof.h"
+
+// headless server, only links ode and enet:
+//   dedicated [--port 12345] [--tick-rate 120] [--broadcast-rate 60] [--max-catchup 5]
+//             [--bounds minX,minY,minZ,maxX,maxY,maxZ] [--interest-radius 48] [--interest-cell 8]
+//             [--snapshot-budget 1200] [--max-players 32] [--telemetry FILE]
+//             [--stepper exact|quick|auto] [--quick-iterations 20] [--quick-sor 1.3]
+//             [--quick-above 1500] [--exact-below 1000] [--no-sleep] [--sleep-linear 0.05]
+//             [--sleep-angular 0.1] [--sleep-steps 30] [--broadphase hash|sap|quadtree|simple]
+//             [--hash-levels -3,10] [--quadtree-depth 6] [--physics-threads 1] [--verbose]
+// SIGUSR1 starts a trace capture and the next one writes it out, see prof.h
+
+static volatile sig_atomic_t traceToggles = 0;
+
+static void HandleSignal(i32 sig) {
+    (void)sig;
+    Arena_RequestStop();
+}
+
+#ifdef SIGUSR1
+static void HandleTraceSignal(i32 sig) {
+    (void)sig;
+    traceToggles++;
+}
+#endif
+
+static i8 OnFrame(const ArenaStats* stats, void* user) {
+    (void)stats;
+    (void)user;
+    static sig_atomic_t handled = 0;
+    if (handled != traceToggles) {
+        handled = traceToggles;
+        Prof_ToggleCapture();
+    }
+    return 0;
+}
+
+static void PrintUsage(const i8* exe) {
+    fprintf(stderr, "usage: %s [--port PORT] [--tick-rate HZ] [--broadcast-rate HZ] [--max-catchup TICKS] [--bounds MINX,MINY,MINZ,MAXX,MAXY,MAXZ] [--interest-radius M] [--interest-cell M] [--snapshot-budget BYTES] [--snapshot-max-rtt SECONDS] [--max-players N] [--telemetry FILE] [--stepper exact|quick|auto] [--quick-iterations N] [--quick-sor W] [--quick-above CONTACTS] [--exact-below CONTACTS] [--no-sleep] [--sleep-linear M/S] [--sleep-angular RAD/S] [--sleep-steps N] [--broadphase hash|sap|quadtree|simple] [--hash-levels MIN,MAX] [--quadtree-depth N] [--physics-threads N] [--verbose]\n", exe);
+}
+
+i32 main(i32 argc, i8** argv) {
+    ArenaConfig config = ARENA_DEFAULT_CONFIG;
+
+    for (i32 i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--port") && i + 1 < argc) {
+            config.port = (u16)atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--tick-rate") && i + 1 < argc) {
+            config.tickRate = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--broadcast-rate") && i + 1 < argc) {
+            config.broadcastRate = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--max-catchup") && i + 1 < argc) {
+            config.maxCatchUp = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--bounds") && i + 1 < argc) {
+            QuantBounds* b = &config.bounds;
+            if (6 != sscanf(argv[++i], "%f,%f,%f,%f,%f,%f", &b->min.x, &b->min.y, &b->min.z, &b->max.x, &b->max.y, &b->max.z)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (0 == strcmp(argv[i], "--interest-radius") && i + 1 < argc) {
+            config.interestRadius = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--interest-cell") && i + 1 < argc) {
+            config.interestCell = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--snapshot-budget") && i + 1 < argc) {
+            config.snapshotBudget = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--snapshot-max-rtt") && i + 1 < argc) {
+            config.snapshotMaxRtt = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--max-players") && i + 1 < argc) {
+            config.maxPlayers = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--telemetry") && i + 1 < argc) {
+            config.telemetryPath = argv[++i];
+        } else if (0 == strcmp(argv[i], "--stepper") && i + 1 < argc) {
+            if (World_ParseStepper(argv[++i], &config.physics.stepper) != 0) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (0 == strcmp(argv[i], "--quick-iterations") && i + 1 < argc) {
+            config.physics.quickIterations = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--quick-sor") && i + 1 < argc) {
+            config.physics.quickSOR = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--quick-above") && i + 1 < argc) {
+            config.physics.quickAbove = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--exact-below") && i + 1 < argc) {
+            config.physics.exactBelow = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--no-sleep")) {
+            config.physics.sleep = 0;
+        } else if (0 == strcmp(argv[i], "--sleep-linear") && i + 1 < argc) {
+            config.physics.sleepLinear = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--sleep-angular") && i + 1 < argc) {
+            config.physics.sleepAngular = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--sleep-steps") && i + 1 < argc) {
+            config.physics.sleepSteps = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--broadphase") && i + 1 < argc) {
+            if (World_ParseBroadphase(argv[++i], &config.physics.broadphase) != 0) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (0 == strcmp(argv[i], "--hash-levels") && i + 1 < argc) {
+            if (2 != sscanf(argv[++i], "%d,%d", &config.physics.hashMinLevel, &config.physics.hashMaxLevel)) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (0 == strcmp(argv[i], "--quadtree-depth") && i + 1 < argc) {
+            config.physics.quadDepth = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--physics-threads") && i + 1 < argc) {
+            config.physics.threads = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--verbose")) {
+            logMinLevel = LOGLEVEL_DEBUG;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    const QuantBounds* b = &config.bounds;
+    if (config.tickRate <= 0.0 || config.broadcastRate <= 0.0 || b->min.x >= b->max.x || b->min.y >= b->max.y || b->min.z >= b->max.z || config.interestRadius < 0.f || config.interestCell <= 0.f || config.snapshotBudget <= 0 || config.snapshotMaxRtt < 0.0 || config.maxPlayers < 1 || config.maxPlayers > PLAYER_LIMIT || config.physics.quickIterations < 1 || config.physics.quickSOR <= 0.f || config.physics.quickSOR >= 2.f || config.physics.exactBelow > config.physics.quickAbove || config.physics.sleepLinear < 0.f || config.physics.sleepAngular < 0.f || config.physics.sleepSteps < 1 || config.physics.hashMinLevel > config.physics.hashMaxLevel || config.physics.quadDepth < 1 || config.physics.threads < 1) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+#ifdef SIGUSR1
+    signal(SIGUSR1, HandleTraceSignal);
+#endif
+
+    return Arena_Run(&config, OnFrame, NULL);
+}
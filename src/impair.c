@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../inc/impair.h"
+#include "../inc/log.h"
+
+#define REORDER_HOLD 0.02 // seconds on top of the jitter, enough for the next packet or two at game rates
+#define LINE_SIZE 512
+
+i8 Impair_ParseSetting(ImpairSettings* s, const i8* key, const i8* value) {
+    i8* end;
+    const f64 v = strtod(value, &end);
+    if (end == value || '\0' != *end || v < 0.0 || isnan(v)) {
+        return 1;
+    }
+
+    if (0 == strcmp(key, "latency")) {
+        s->latency = v / 1000.0;
+    } else if (0 == strcmp(key, "jitter")) {
+        s->jitter = v / 1000.0;
+    } else if (0 == strcmp(key, "queue")) {
+        s->queueTime = v / 1000.0;
+    } else if (0 == strcmp(key, "rate")) {
+        s->rate = v * 1000.0 / 8.0;
+    } else if (v > 100.0) {
+        return 1;
+    } else if (0 == strcmp(key, "loss")) {
+        s->loss = v / 100.0;
+    } else if (0 == strcmp(key, "dup")) {
+        s->duplicate = v / 100.0;
+    } else if (0 == strcmp(key, "reorder")) {
+        s->reorder = v / 100.0;
+    } else {
+        return 1;
+    }
+    return 0;
+}
+
+i8 Impair_LoadProfile(ImpairProfile* p, const i8* path, ImpairSettings base) {
+    p->steps = NULL;
+    p->count = 0;
+
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        Log_Write(LOGLEVEL_ERROR, "profile_open_failed", "path=%s", path);
+        return 1;
+    }
+
+    i8 line[LINE_SIZE];
+    i32 lineNumber = 0, capacity = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNumber++;
+        i8* comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        i8* save;
+        const i8* timeToken = strtok_r(line, " \t\r\n", &save);
+        if (!timeToken) {
+            continue;
+        }
+
+        ImpairStep step = { .settings = p->count > 0 ? p->steps[p->count - 1].settings : base };
+        i8* end;
+        step.time = strtod(timeToken, &end);
+        i8 bad = end == timeToken || '\0' != *end || step.time < 0.0 || (p->count > 0 && step.time < p->steps[p->count - 1].time);
+        for (i8* token = strtok_r(NULL, " \t\r\n", &save); token && !bad; token = strtok_r(NULL, " \t\r\n", &save)) {
+            i8* eq = strchr(token, '=');
+            if (!eq) {
+                bad = 1;
+                break;
+            }
+            *eq = '\0';
+            bad = Impair_ParseSetting(&step.settings, token, eq + 1);
+        }
+        if (bad) {
+            Log_Write(LOGLEVEL_ERROR, "bad_profile", "path=%s line=%d", path, lineNumber);
+            fclose(f);
+            Impair_FreeProfile(p);
+            return 1;
+        }
+
+        if (p->count == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            ImpairStep* steps = realloc(p->steps, sizeof(ImpairStep) * capacity);
+            if (!steps) {
+                fclose(f);
+                Impair_FreeProfile(p);
+                return 1;
+            }
+            p->steps = steps;
+        }
+        p->steps[p->count++] = step;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+void Impair_FreeProfile(ImpairProfile* p) {
+    free(p->steps);
+    p->steps = NULL;
+    p->count = 0;
+}
+
+ImpairSettings Impair_ProfileAt(const ImpairProfile* p, f64 time, ImpairSettings base) {
+    for (i32 i = p->count - 1; i >= 0; i--) {
+        if (p->steps[i].time <= time) {
+            return p->steps[i].settings;
+        }
+    }
+    return base;
+}
+
+// splitmix64
+static u64 Next(ImpairLink* l) {
+    u64 z = (l->rng += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// uniform in [0, 1)
+static f64 Roll(ImpairLink* l) {
+    return (Next(l) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void Impair_Init(ImpairLink* l, ImpairSettings settings, u64 seed) {
+    memset(l, 0, sizeof(*l));
+    l->settings = settings;
+    l->rng = seed;
+}
+
+void Impair_Free(ImpairLink* l) {
+    for (i32 i = 0; i < l->count; i++) {
+        free(l->heap[i].data);
+    }
+    free(l->heap);
+    l->heap = NULL;
+    l->count = l->capacity = 0;
+}
+
+static i8 Earlier(const ImpairPacket* a, const ImpairPacket* b) {
+    return a->due < b->due || (a->due == b->due && (i32)(a->order - b->order) < 0);
+}
+
+static i8 Queue(ImpairLink* l, const u8* data, size_t len, f64 due) {
+    if (l->count == l->capacity) {
+        const i32 capacity = l->capacity ? l->capacity * 2 : 64;
+        ImpairPacket* heap = realloc(l->heap, sizeof(ImpairPacket) * capacity);
+        if (!heap) {
+            return 1;
+        }
+        l->heap = heap;
+        l->capacity = capacity;
+    }
+
+    ImpairPacket packet = { .due = due, .order = l->nextOrder++, .data = malloc(len ? len : 1), .len = len };
+    if (!packet.data) {
+        return 1;
+    }
+    memcpy(packet.data, data, len);
+
+    i32 i = l->count++;
+    while (i > 0 && Earlier(&packet, &l->heap[(i - 1) / 2])) {
+        l->heap[i] = l->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    l->heap[i] = packet;
+    return 0;
+}
+
+i8 Impair_Push(ImpairLink* l, const u8* data, size_t len, f64 now) {
+    const ImpairSettings* s = &l->settings;
+    l->stats.packetsIn++;
+    l->stats.bytesIn += len;
+
+    // always the same number of rolls per packet, so what happens to the nth packet
+    // only depends on the seed and the settings, not on what happened to the others
+    const f64 lossRoll = Roll(l);
+    const f64 duplicateRoll = Roll(l);
+    const f64 reorderRoll = Roll(l);
+    const f64 jitterRolls[2] = { Roll(l), Roll(l) };
+
+    if (lossRoll < s->loss) {
+        l->stats.lost++;
+        return 0;
+    }
+
+    // the rate limit is a queue in front of the wire, a packet that would wait longer than queueTime is dropped
+    f64 sent = now;
+    if (s->rate > 0.f) {
+        const f64 start = fmax(now, l->busyUntil);
+        if (start - now > s->queueTime) {
+            l->stats.overflowed++;
+            return 0;
+        }
+        l->busyUntil = sent = start + len / s->rate;
+    }
+
+    const i32 copies = duplicateRoll < s->duplicate ? 2 : 1;
+    l->stats.duplicated += copies - 1;
+    for (i32 i = 0; i < copies; i++) {
+        f64 due = sent + s->latency + s->jitter * jitterRolls[i];
+        if (0 == i && reorderRoll < s->reorder) {
+            due += s->jitter + REORDER_HOLD;
+            l->stats.reordered++;
+        } else {
+            // a real queue doesn't let packets pass each other, jitter only bunches them up
+            due = fmax(due, l->lastInOrder);
+            l->lastInOrder = due;
+        }
+        if (Queue(l, data, len, due) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+i8 Impair_Pop(ImpairLink* l, f64 now, ImpairPacket* res) {
+    if (0 == l->count || l->heap[0].due > now) {
+        return 0;
+    }
+    *res = l->heap[0];
+    l->stats.packetsOut++;
+    l->stats.bytesOut += res->len;
+
+    const ImpairPacket last = l->heap[--l->count];
+    i32 i = 0;
+    for (;;) {
+        i32 child = 2 * i + 1;
+        if (child >= l->count) {
+            break;
+        }
+        if (child + 1 < l->count && Earlier(&l->heap[child + 1], &l->heap[child])) {
+            child++;
+        }
+        if (!Earlier(&l->heap[child], &last)) {
+            break;
+        }
+        l->heap[i] = l->heap[child];
+        i = child;
+    }
+    if (l->count > 0) {
+        l->heap[i] = last;
+    }
+    return 1;
+}
+
+f64 Impair_NextDue(const ImpairLink* l) {
+    return l->count > 0 ? l->heap[0].due : -1.0;
+}
@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "raymath.h"
+
+#include "../inc/interp.h"
+
+#define SMOOTHING 0.1        // weight of each new sample in the running averages
+#define DELAY_SMOOTHING 0.02 // the delay moves slowly so render time never jumps
+#define JITTER_SCALE 3.0     // how many mean deviations of slack to keep buffered
+
+i8 Interp_Init(InterpBuffer* b, i32 capacity, f64 tickTime, f64 minDelay) {
+    b->capacity = capacity;
+    b->tickTime = tickTime;
+    b->minDelay = b->delay = minDelay;
+    b->newest = -1;
+    b->count = 0;
+    b->offset = b->jitter = b->interval = 0.0;
+    for (i32 i = 0; i < INTERP_FRAMES; i++) {
+        b->frames[i] = malloc(sizeof(BodyState) * capacity);
+        if (!b->frames[i]) {
+            Interp_Free(b);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void Interp_Free(InterpBuffer* b) {
+    for (i32 i = 0; i < INTERP_FRAMES; i++) {
+        free(b->frames[i]);
+        b->frames[i] = NULL;
+    }
+}
+
+void Interp_Push(InterpBuffer* b, const BodyState* states, u32 tick, f64 now) {
+    const f64 serverTime = tick * b->tickTime;
+    const f64 offset = now - serverTime;
+    if (0 == b->count) {
+        b->offset = offset;
+    } else {
+        const u32 lastTick = b->ticks[b->newest];
+        if (tick <= lastTick) {
+            return;
+        }
+
+        // a snapshot that shows up late pushes the deviation up, one that shows up
+        // early drags the offset down quickly since it's the closer estimate of the real latency
+        const f64 deviation = offset - b->offset;
+        b->jitter += (fabs(deviation) - b->jitter) * SMOOTHING;
+        b->offset += deviation * (deviation < 0.0 ? 0.5 : SMOOTHING * 0.1);
+        b->interval += ((tick - lastTick) * b->tickTime - b->interval) * SMOOTHING;
+
+        const f64 target = fmax(b->minDelay, b->interval + JITTER_SCALE * b->jitter);
+        b->delay += (target - b->delay) * DELAY_SMOOTHING;
+    }
+
+    b->newest = (b->newest + 1) % INTERP_FRAMES;
+    b->count = b->count < INTERP_FRAMES ? b->count + 1 : INTERP_FRAMES;
+    b->ticks[b->newest] = tick;
+    memcpy(b->frames[b->newest], states, sizeof(BodyState) * b->capacity);
+}
+
+// same element order as GetRLFromODEMat, so raymath sees the rotation the renderer does
+static Quaternion RotationOf(const dReal trans[16]) {
+    return QuaternionFromMatrix((Matrix){
+        .m0 = trans[0], .m1 = trans[1], .m2  = trans[2],
+        .m4 = trans[4], .m5 = trans[5], .m6  = trans[6],
+        .m8 = trans[8], .m9 = trans[9], .m10 = trans[10],
+        .m15 = 1.f
+    });
+}
+
+static void Blend(BodyState* res, const BodyState* from, const BodyState* to, f32 t) {
+    *res = *to;
+
+    const Matrix rot = QuaternionToMatrix(QuaternionSlerp(RotationOf(from->transform), RotationOf(to->transform), t));
+    const f32 m[12] = {
+        rot.m0, rot.m1, rot.m2, rot.m3,
+        rot.m4, rot.m5, rot.m6, rot.m7,
+        rot.m8, rot.m9, rot.m10, rot.m11
+    };
+    for (i32 i = 0; i < 12; i++) {
+        res->transform[i] = m[i];
+    }
+    for (i32 i = 12; i < 15; i++) {
+        res->transform[i] = LERP(from->transform[i], to->transform[i], t);
+    }
+}
+
+i8 Interp_Sample(InterpBuffer* b, f64 now, BodyState* res) {
+    if (0 == b->count) {
+        return 0;
+    }
+
+    // newest first, find the pair of snapshots around the render time
+    const f64 renderTick = (now - b->offset - b->delay) / b->tickTime;
+    i32 to = b->newest, from = b->newest;
+    for (i32 n = 1; n < b->count; n++) {
+        const i32 i = (b->newest - n + INTERP_FRAMES) % INTERP_FRAMES;
+        from = i;
+        if (b->ticks[i] <= renderTick) {
+            break;
+        }
+        to = i;
+    }
+
+    // past the newest one it holds still rather than guessing, before the oldest it holds that
+    f32 t = 1.f;
+    if (from != to) {
+        t = (renderTick - b->ticks[from]) / (f64)(b->ticks[to] - b->ticks[from]);
+        t = t < 0.f ? 0.f : t > 1.f ? 1.f : t;
+    }
+
+    const BodyState* a = b->frames[from];
+    const BodyState* c = b->frames[to];
+    for (i32 i = 0; i < b->capacity; i++) {
+        // bodies that spawn or vanish in between just pop, blending them would mean inventing a pose.
+        // asleep in both means the pose is the same in both
+        if (BODYTYPE_NULL == c[i].type || a[i].type != c[i].type || from == to || (!a[i].isAwake && !c[i].isAwake)) {
+            res[i] = c[i];
+            continue;
+        }
+        Blend(&res[i], &a[i], &c[i], t);
+    }
+    return 1;
+}
@@ -0,0 +1,514 @@
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "enet/enet.h"
+
+#include "../inc/util.h"
+#include "../inc/log.h"
+#include "../inc/tick.h"
+#include "../inc/msgs.h"
+#include "../inc/move.h"
+#include "../inc/snapshot.h"
+#include "../inc/rand.h"
+#include "../inc/transform.h"
+
+// headless bots speaking the real protocol from one process, to see how many players
+// a server holds. each one wanders around, streams inputs and spawns bodies the way
+// KEY_M and KEY_SPACE do in the game, and decodes and acks every snapshot.
+// no window or GPU, only links enet:
+//   loadgen [--host 127.0.0.1] [--port 12345] [--clients 32] [--duration 30] [--connect-rate 50]
+//           [--spawn-interval 2] [--report-interval 5] [--seed 1] [--verbose]
+
+#define FRAME_TIME (1.0 / 60.0)
+#define INPUT_SEND_TIME (1.f / 30.f) // same as the game
+#define WANDER_TIME 1.5f             // seconds between picking new buttons
+#define SMOOTHING 0.1                // weight of each new snapshot gap in the running averages
+#define DISCONNECT_TIMEOUT 1.0       // seconds to wait for the server to confirm disconnects
+
+typedef struct bot {
+    i32 index;
+    ENetPeer* peer;
+    i32 id;         // -1 until MsgPlayerID arrives
+    u8 connected;
+    u8 leaving;     // we asked to disconnect
+    u8 gone;        // disconnected, never reconnects
+
+    MovePredictor move;
+    SnapReceiver snaps;
+    MsgUpdatePlayers update;
+    u16 buttons;
+    f32 yaw, pitch, turn;
+    f32 inputTimer, spawnTimer, wanderTimer;
+
+    // everything below is what gets reported
+    f64 connectTime; // from connecting to getting an id, seconds
+    u64 bytesIn, bytesOut; // message payloads, without enet or udp headers
+    u32 packetsIn, packetsOut;
+    u32 rttMin, rttMax;
+    u64 rttSum;
+    u32 rttSamples;
+
+    u32 snapshots, badSnapshots;
+    f64 lastSnapshot; // local arrival time
+    f64 interval;     // smoothed time between snapshots
+    f64 jitter;       // mean deviation of that time from interval
+    f64 maxGap;
+
+    // from MsgServerStats, the first one seen and the newest
+    u8 haveStats;
+    MsgServerStats firstStats, lastStats;
+} Bot;
+
+typedef struct loadConfig {
+    const i8* host;
+    u16 port;
+    i32 clients;
+    f64 duration;
+    f64 connectRate;    // new connections per second
+    f32 spawnInterval;  // seconds between each bot's spawns, 0 for none
+    f64 reportInterval;
+} LoadConfig;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void HandleSignal(i32 sig) {
+    (void)sig;
+    stopRequested = 1;
+}
+
+static void PrintUsage(const i8* exe) {
+    fprintf(stderr, "usage: %s [--host HOST] [--port PORT] [--clients N] [--duration SECONDS] [--connect-rate PER_SECOND] [--spawn-interval SECONDS] [--report-interval SECONDS] [--seed N] [--verbose]\n", exe);
+}
+
+static void Send(Bot* b, u8 channel, const u8* data, size_t len, u32 flags) {
+    enet_peer_send(b->peer, channel, enet_packet_create(data, len, flags));
+    b->bytesOut += len;
+    b->packetsOut++;
+}
+
+static void FreeBot(Bot* b) {
+    if (-1 != b->id) {
+        Snapshot_ReceiverFree(&b->snaps);
+    }
+    free(b->update.slots);
+    free(b->update.players);
+    b->update.slots = NULL;
+    b->update.players = NULL;
+}
+
+static void HandlePlayerID(Bot* b, const u8* data, size_t len, f64 now, f64 startTime) {
+    MsgPlayerID msg;
+    if (-1 != b->id || Msg_ReadPlayerID(data, len, &msg) != 0) {
+        return;
+    }
+    b->update.slots = malloc(sizeof(i32) * msg.maxPlayers);
+    b->update.players = malloc(sizeof(PlayerState) * msg.maxPlayers);
+    if (!b->update.slots || !b->update.players || Snapshot_ReceiverInit(&b->snaps, MAX_BODIES, msg.snapshotHistory, msg.bounds) != 0) {
+        Log_Write(LOGLEVEL_ERROR, "bot_alloc_failed", "bot=%d max_players=%d", b->index, msg.maxPlayers);
+        enet_peer_disconnect(b->peer, DISCONNECT_NONE);
+        return;
+    }
+    b->update.capacity = msg.maxPlayers;
+
+    PlayerState spawn;
+    Move_Spawn(&spawn);
+    spawn.id = b->id = msg.playerID;
+    Move_PredictorInit(&b->move, &spawn);
+    b->connectTime = now - startTime;
+    Log_Write(LOGLEVEL_DEBUG, "bot_id", "bot=%d id=%d max_players=%d", b->index, b->id, msg.maxPlayers);
+}
+
+static void HandleSnapshot(Bot* b, const u8* data, size_t len, f64 now) {
+    const u32 seq = Snapshot_Decode(&b->snaps, data, len);
+    if (0 == seq) {
+        b->badSnapshots++;
+        return;
+    }
+
+    u8 buf[MSG_MAX_SIZE];
+    const size_t ackLen = Msg_WriteSnapshotAck(buf, sizeof(buf), &(MsgSnapshotAck){ .seq = seq });
+    Send(b, CHANNEL_STATE, buf, ackLen, 0);
+
+    // same estimate as the interpolation buffer, how unevenly they arrive matters more than how late
+    if (b->snapshots > 0) {
+        const f64 gap = now - b->lastSnapshot;
+        if (b->snapshots > 1) {
+            b->jitter += (fabs(gap - b->interval) - b->jitter) * SMOOTHING;
+            b->interval += (gap - b->interval) * SMOOTHING;
+        } else {
+            b->interval = gap;
+        }
+        b->maxGap = fmax(b->maxGap, gap);
+    }
+    b->lastSnapshot = now;
+    b->snapshots++;
+}
+
+static void HandleReceive(Bot* b, const u8* data, size_t len, f64 now, f64 startTime) {
+    b->bytesIn += len;
+    b->packetsIn++;
+
+    const i32 type = Msg_Type(data, len);
+    if (MSGTYPE_C_PLAYER_ID == type) {
+        HandlePlayerID(b, data, len, now, startTime);
+        return;
+    }
+    if (-1 == b->id) {
+        return;
+    }
+
+    switch (type) {
+        case MSGTYPE_C_UPDATE_PLAYERS: {
+            if (Msg_ReadUpdatePlayers(data, len, &b->update) != 0) {
+                break;
+            }
+            // the others are only decoded, a bot never looks at them
+            for (i32 i = 0; i < b->update.count; i++) {
+                if (b->update.slots[i] == b->id && -1 != b->update.players[i].id) {
+                    Move_Reconcile(&b->move, &b->update.players[i]);
+                }
+            }
+        } break;
+        case MSGTYPE_C_SNAPSHOT: {
+            HandleSnapshot(b, data, len, now);
+        } break;
+        case MSGTYPE_C_LEVEL_LOAD: {
+            BodyState* level = malloc(sizeof(BodyState) * MAX_BODIES);
+            if (level && Snapshot_DecodeLevel(level, MAX_BODIES, data, len) < 0) {
+                Log_Write(LOGLEVEL_WARN, "bad_level", "bot=%d len=%zu", b->index, len);
+            }
+            free(level);
+        } break;
+        case MSGTYPE_C_SERVER_STATS: {
+            MsgServerStats stats;
+            if (Msg_ReadServerStats(data, len, &stats) != 0) {
+                break;
+            }
+            if (!b->haveStats) {
+                b->firstStats = stats;
+                b->haveStats = 1;
+            }
+            b->lastStats = stats;
+        } break;
+        default: break;
+    }
+}
+
+static void SpawnBody(Bot* b) {
+    BodyState state = { .col = Rand_Color(30, 190) };
+    Vector3 pos = b->move.state.pos;
+    switch (Rand_Int(0, 3)) {
+        case 0: {
+            state.type = BODYTYPE_BOX;
+            state.size = (Vector3){Rand_Double(0.2, 1.0), Rand_Double(0.2, 1.0), Rand_Double(0.2, 1.0)};
+            pos = (Vector3){Rand_Double(-4.0, 4.0), Rand_Double(20.0, 50.0), Rand_Double(-4.0, 4.0)};
+        } break;
+        case 1: {
+            state.type = BODYTYPE_SPHERE;
+            state.size = (Vector3){Rand_Double(0.1, 0.4), 0.f, 0.f};
+            pos = (Vector3){Rand_Double(-4.0, 4.0), Rand_Double(20.0, 50.0), Rand_Double(-4.0, 4.0)};
+        } break;
+        default: {
+            // dropped where the bot stands, like KEY_SPACE
+            state.type = BODYTYPE_SPHERE;
+            state.size = (Vector3){0.15, 0.f, 0.f};
+        } break;
+    }
+    GetTransformMatV(state.transform, pos, (Vector3){0.f, 0.f, 0.f});
+
+    u8 buf[MSG_MAX_SIZE];
+    const size_t len = Msg_WriteNewBody(buf, sizeof(buf), &(MsgNewBody){ .body = state });
+    Send(b, CHANNEL_RELIABLE, buf, len, ENET_PACKET_FLAG_RELIABLE);
+}
+
+static void UpdateBot(Bot* b, const LoadConfig* config, f32 dt) {
+    // wander, with some standing still so the idle path gets exercised too
+    b->wanderTimer -= dt;
+    if (b->wanderTimer <= 0.f) {
+        b->wanderTimer = Rand_Double(0.5 * WANDER_TIME, 1.5 * WANDER_TIME);
+        b->buttons = Rand_Int(0, 4) == 0 ? 0 : (u16)(Rand_Next() & ((1 << INPUT_BUTTON_BITS) - 1));
+        b->turn = Rand_Double(-TURN_SPEED, TURN_SPEED);
+    }
+    if (b->buttons) {
+        b->yaw += b->turn * dt;
+    }
+    Move_Predict(&b->move, b->buttons, b->yaw, b->pitch, dt);
+
+    b->inputTimer += dt;
+    if (b->inputTimer >= INPUT_SEND_TIME) {
+        MsgPlayerInput msg;
+        while ((msg.count = Move_NextInputs(&b->move, msg.inputs, MOVE_MAX_INPUTS)) > 0) {
+            u8 buf[MSG_MAX_SIZE];
+            const size_t len = Msg_WritePlayerInput(buf, sizeof(buf), &msg);
+            Send(b, CHANNEL_STATE, buf, len, 0);
+        }
+        b->inputTimer = 0.f;
+
+        const u32 rtt = b->peer->roundTripTime;
+        b->rttMin = 0 == b->rttSamples || rtt < b->rttMin ? rtt : b->rttMin;
+        b->rttMax = rtt > b->rttMax ? rtt : b->rttMax;
+        b->rttSum += rtt;
+        b->rttSamples++;
+    }
+
+    if (config->spawnInterval > 0.f) {
+        b->spawnTimer -= dt;
+        if (b->spawnTimer <= 0.f) {
+            b->spawnTimer += config->spawnInterval;
+            SpawnBody(b);
+        }
+    }
+}
+
+static void HandleEvent(const ENetEvent* event, f64 now, f64 startTime) {
+    Bot* b = event->peer->data;
+    if (!b) {
+        return;
+    }
+
+    switch (event->type) {
+        case ENET_EVENT_TYPE_CONNECT: {
+            b->connected = 1;
+        } break;
+        case ENET_EVENT_TYPE_RECEIVE: {
+            HandleReceive(b, event->packet->data, event->packet->dataLength, now, startTime);
+        } break;
+        case ENET_EVENT_TYPE_DISCONNECT: {
+            if (!b->leaving) {
+                Log_Write(LOGLEVEL_WARN, "bot_disconnect", "bot=%d id=%d reason=%s", b->index, b->id,
+                    DISCONNECT_FULL == event->data ? "full" : DISCONNECT_VERSION == event->data ? "version" : DISCONNECT_SERVER_ERROR == event->data ? "server_error" : b->connected ? "dropped" : "timeout");
+            }
+            b->connected = 0;
+            b->gone = 1;
+            event->peer->data = NULL;
+        } break;
+        default: break;
+    }
+}
+
+// handles events until the deadline, arrivals are timestamped as they're handled
+static void Service(ENetHost* host, f64 deadline, f64 startTime) {
+    ENetEvent event;
+    for (f64 now = Tick_Now(); now < deadline; now = Tick_Now()) {
+        const enet_uint32 wait = (enet_uint32)((deadline - now) * 1000.0);
+        const i32 got = enet_host_service(host, &event, wait);
+        if (got < 0) {
+            return;
+        }
+        if (0 == got) {
+            if (0 == wait) {
+                return;
+            }
+            continue;
+        }
+        HandleEvent(&event, Tick_Now(), startTime);
+        if (ENET_EVENT_TYPE_RECEIVE == event.type) {
+            enet_packet_destroy(event.packet);
+        }
+    }
+}
+
+static void LogBot(const Bot* b) {
+    Log_Write(LOGLEVEL_INFO, "bot", "bot=%d id=%d connect_ms=%.1f rtt_min=%u rtt_avg=%.1f rtt_max=%u bytes_in=%llu bytes_out=%llu packets_in=%u packets_out=%u snapshots=%u bad_snapshots=%u snapshot_interval_ms=%.2f snapshot_jitter_ms=%.2f snapshot_max_gap_ms=%.1f",
+        b->index, b->id, b->connectTime * 1000.0, b->rttMin, b->rttSamples ? (f64)b->rttSum / b->rttSamples : 0.0, b->rttMax,
+        (unsigned long long)b->bytesIn, (unsigned long long)b->bytesOut, b->packetsIn, b->packetsOut,
+        b->snapshots, b->badSnapshots, b->interval * 1000.0, b->jitter * 1000.0, b->maxGap * 1000.0);
+}
+
+// totals over every bot that got an id, elapsed is seconds since the first connect
+static void LogSummary(const Bot* bots, i32 count, f64 elapsed, const i8* event) {
+    i32 joined = 0, connected = 0;
+    u64 bytesIn = 0, bytesOut = 0, rttSum = 0, rttSamples = 0;
+    u32 rttMax = 0, snapshots = 0, badSnapshots = 0;
+    f64 jitterSum = 0.0, jitterMax = 0.0;
+
+    // the server sends every bot the same stats, use whichever heard the most of them
+    const MsgServerStats* first = NULL;
+    const MsgServerStats* last = NULL;
+    for (i32 i = 0; i < count; i++) {
+        const Bot* b = &bots[i];
+        connected += b->connected;
+        if (-1 == b->id) {
+            continue;
+        }
+        joined++;
+        bytesIn += b->bytesIn;
+        bytesOut += b->bytesOut;
+        rttSum += b->rttSum;
+        rttSamples += b->rttSamples;
+        rttMax = b->rttMax > rttMax ? b->rttMax : rttMax;
+        snapshots += b->snapshots;
+        badSnapshots += b->badSnapshots;
+        jitterSum += b->jitter;
+        jitterMax = fmax(jitterMax, b->jitter);
+        if (b->haveStats && (!first || b->firstStats.tick < first->tick)) {
+            first = &b->firstStats;
+        }
+        if (b->haveStats && (!last || b->lastStats.tick > last->tick)) {
+            last = &b->lastStats;
+        }
+    }
+
+    const f64 seconds = elapsed > 0.0 ? elapsed : 1.0;
+    Log_Write(LOGLEVEL_INFO, event, "elapsed=%.1f bots=%d joined=%d connected=%d rtt_avg=%.1f rtt_max=%u kbps_in=%.1f kbps_out=%.1f snapshots=%u bad_snapshots=%u jitter_avg_ms=%.2f jitter_max_ms=%.2f server_tick=%u server_overruns=%u server_dropped_ticks=%u",
+        elapsed, count, joined, connected, rttSamples ? (f64)rttSum / rttSamples : 0.0, rttMax,
+        bytesIn * 8.0 / 1000.0 / seconds, bytesOut * 8.0 / 1000.0 / seconds, snapshots, badSnapshots,
+        joined ? jitterSum / joined * 1000.0 : 0.0, jitterMax * 1000.0,
+        last ? last->tick : 0, last ? last->overruns - first->overruns : 0, last ? last->droppedTicks - first->droppedTicks : 0);
+}
+
+i32 main(i32 argc, i8** argv) {
+    LoadConfig config = {
+        .host = "127.0.0.1",
+        .port = 12345,
+        .clients = 32,
+        .duration = 30.0,
+        .connectRate = 50.0,
+        .spawnInterval = 2.f,
+        .reportInterval = 5.0
+    };
+    randState = 1;
+
+    for (i32 i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--host") && i + 1 < argc) {
+            config.host = argv[++i];
+        } else if (0 == strcmp(argv[i], "--port") && i + 1 < argc) {
+            config.port = (u16)atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--clients") && i + 1 < argc) {
+            config.clients = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--duration") && i + 1 < argc) {
+            config.duration = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--connect-rate") && i + 1 < argc) {
+            config.connectRate = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--spawn-interval") && i + 1 < argc) {
+            config.spawnInterval = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--report-interval") && i + 1 < argc) {
+            config.reportInterval = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--seed") && i + 1 < argc) {
+            randState = (u32)strtoul(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--verbose")) {
+            logMinLevel = LOGLEVEL_DEBUG;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // enet can't address more peers than that from one host
+    if (config.clients < 1 || config.clients > 4095 || config.duration <= 0.0 || config.connectRate <= 0.0 || config.spawnInterval < 0.f || config.reportInterval <= 0.0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    if (enet_initialize() != 0) {
+        Log_Write(LOGLEVEL_ERROR, "enet_init_failed", "");
+        return 1;
+    }
+
+    ENetHost* host = enet_host_create(NULL, config.clients, CHANNEL_COUNT, 0, 0);
+    Bot* bots = calloc(config.clients, sizeof(Bot));
+    if (!host || !bots) {
+        Log_Write(LOGLEVEL_ERROR, "host_create_failed", "clients=%d", config.clients);
+        free(bots);
+        if (host) {
+            enet_host_destroy(host);
+        }
+        enet_deinitialize();
+        return 1;
+    }
+
+    ENetAddress address = { .port = config.port };
+    if (enet_address_set_host(&address, config.host) != 0) {
+        Log_Write(LOGLEVEL_ERROR, "bad_host", "host=%s", config.host);
+        free(bots);
+        enet_host_destroy(host);
+        enet_deinitialize();
+        return 1;
+    }
+
+    Log_Write(LOGLEVEL_INFO, "loadgen_start", "host=%s port=%u clients=%d duration=%.1f connect_rate=%.1f spawn_interval=%.2f version=%u",
+        config.host, config.port, config.clients, config.duration, config.connectRate, config.spawnInterval, PROTOCOL_VERSION);
+
+    const f64 startTime = Tick_Now();
+    f64 nextFrame = startTime, nextReport = startTime + config.reportInterval, lastFrame = startTime;
+    i32 started = 0;
+    while (!stopRequested) {
+        const f64 now = Tick_Now();
+        if (now - startTime >= config.duration) {
+            break;
+        }
+
+        // ramp up instead of opening everything in one burst, like real players arriving
+        while (started < config.clients && (now - startTime) * config.connectRate >= started) {
+            Bot* b = &bots[started];
+            b->index = started++;
+            b->id = -1;
+            b->spawnTimer = Rand_Double(0.0, config.spawnInterval + 0.001);
+            b->peer = enet_host_connect(host, &address, CHANNEL_COUNT, PROTOCOL_VERSION);
+            if (!b->peer) {
+                Log_Write(LOGLEVEL_ERROR, "connect_failed", "bot=%d", b->index);
+                b->gone = 1;
+                continue;
+            }
+            b->peer->data = b;
+        }
+
+        const f32 dt = (f32)(now - lastFrame);
+        lastFrame = now;
+        for (i32 i = 0; i < started; i++) {
+            if (!bots[i].gone && -1 != bots[i].id) {
+                UpdateBot(&bots[i], &config, dt);
+            }
+        }
+        enet_host_flush(host);
+
+        if (now >= nextReport) {
+            LogSummary(bots, started, now - startTime, "loadgen_report");
+            nextReport += config.reportInterval;
+        }
+
+        nextFrame += FRAME_TIME;
+        if (nextFrame < now) {
+            nextFrame = now; // fell behind, don't try to catch up
+        }
+        Service(host, nextFrame, startTime);
+    }
+
+    const f64 elapsed = Tick_Now() - startTime;
+    for (i32 i = 0; i < started; i++) {
+        LogBot(&bots[i]);
+    }
+    LogSummary(bots, started, elapsed, "loadgen_done");
+
+    // let the server free the slots now rather than when they time out
+    i32 leaving = 0;
+    for (i32 i = 0; i < started; i++) {
+        if (bots[i].peer && !bots[i].gone) {
+            bots[i].leaving = 1;
+            enet_peer_disconnect(bots[i].peer, DISCONNECT_NONE);
+            leaving++;
+        }
+    }
+    const f64 deadline = Tick_Now() + DISCONNECT_TIMEOUT;
+    while (leaving > 0 && Tick_Now() < deadline) {
+        Service(host, fmin(deadline, Tick_Now() + FRAME_TIME), startTime);
+        leaving = 0;
+        for (i32 i = 0; i < started; i++) {
+            leaving += bots[i].leaving && !bots[i].gone;
+        }
+    }
+
+    for (i32 i = 0; i < started; i++) {
+        FreeBot(&bots[i]);
+    }
+    free(bots);
+    enet_host_destroy(host);
+    enet_deinitialize();
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../inc/log.h"
+
+LogLevel logMinLevel = LOGLEVEL_INFO;
+
+#define LINE_MAX_SIZE 512
+
+static i8 lastLine[256] = ""; // only ever shown on screen, so it keeps the first 255 chars of a line
+static pthread_mutex_t lastLineLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const i8* levelNames[] = { "debug", "info", "warn", "error" };
+
+void Log_Write(LogLevel level, const i8* event, const i8* fmt, ...) {
+    if (level < logMinLevel) {
+        return;
+    }
+
+    i8 line[LINE_MAX_SIZE];
+    i32 len = snprintf(line, sizeof(line), "lvl=%s evt=%s ", levelNames[level], event);
+    if (len < 0 || len >= (i32)sizeof(line)) {
+        len = sizeof(line) - 1;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    const i32 want = vsnprintf(line + len, sizeof(line) - len, fmt, args);
+    va_end(args);
+
+    // a cut line still has to parse and say it was cut, so the end makes room for a field
+    if (want < 0) {
+        line[len] = '\0';
+    } else if (len + want >= (i32)sizeof(line)) {
+        static const i8 mark[] = " truncated=1";
+        memcpy(line + sizeof(line) - sizeof(mark), mark, sizeof(mark));
+    }
+
+    const time_t now = time(NULL);
+    i8 ts[32];
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    FILE* out = level >= LOGLEVEL_WARN ? stderr : stdout;
+    fprintf(out, "ts=%s %s\n", ts, line);
+    fflush(out);
+
+    pthread_mutex_lock(&lastLineLock);
+    snprintf(lastLine, sizeof(lastLine), "%.*s", (i32)sizeof(lastLine) - 1, line);
+    pthread_mutex_unlock(&lastLineLock);
+}
+
+const i8* Log_Last(void) {
+    static i8 copy[sizeof(lastLine)];
+    pthread_mutex_lock(&lastLineLock);
+    memcpy(copy, lastLine, sizeof(copy));
+    pthread_mutex_unlock(&lastLineLock);
+    return copy;
+}
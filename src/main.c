@@ -15,39 +15,32 @@
 #include "../inc/rand.h"
 #include "../inc/msgs.h"
 #include "../inc/player.h"
-
-#ifdef _WIN32
-    #include <arpa/inet.h>
-    #include <ifaddrs.h>
-#endif
+#include "../inc/move.h"
+#include "../inc/transform.h"
+#include "../inc/arena.h"
+#include "../inc/log.h"
+#include "../inc/snapshot.h"
+#include "../inc/interp.h"
+#include "../inc/prof.h"
 
 #define MAX_PITCH (89.f * DEG2RAD)
 
 #define SHADOWMAP_RESOLUTION 2048
 
-#define BROADCAST_TIME (1.f / 60.f)
-
-typedef struct peerInfo {
-    ENetPeer* peer;
-    i32 playerID;
-} PeerInfo;
-
-static dWorldID world;
-static dSpaceID space;
-static dJointGroupID contactGroup;
+#define INPUT_SEND_TIME (1.f / 30.f) // inputs are predicted straight away, sending them less often only delays corrections
+#define INTERP_MIN_DELAY 0.05 // bodies are drawn at least this far behind the server, more if snapshots arrive unevenly
 
 static Shader shadowShader;
 
 static ENetHost* host;
 static ENetPeer* peer;
 
-static inline void GetTransformMat(dReal res[16], const dReal* pos, const dReal* rot);
-static inline void GetTransformMatV(dReal res[16], Vector3 pos, Vector3 rot);
+static MovePredictor predictor;
+
 static inline Matrix GetRLFromODEMat(const dReal mat[16]);
+static void DrawProfOverlay(i32 x, i32 y);
 
-static void NearCallback(void* data, dGeomID o1, dGeomID o2);
-static i32 AddBody(Body* bodies, BodyState* states, CollMask category, CollMask collide, BodyState state, i8 isKinematic);
-static i32 AddBodyMap(Body* bodies, BodyState* states, Vector3 pos, Vector3 rot, Vector3 size, Color col);
+static void SetBody(RenderBody* bodies, i32 id, const BodyState* state);
 static void ReleaseBody(RenderBody* bodies, i32 id);
 
 static void ClientAddBody(BodyState body);
@@ -56,215 +49,27 @@ static void ClientAddBody(BodyState body);
 static RenderTexture LoadShadowmapRenderTexture(i32 width, i32 height);
 static void UnloadShadowmapRenderTexture(RenderTexture2D target);
 
-static i8 StartServer(void) {
-    if (enet_initialize() != 0) {
-        TraceLog(LOG_ERROR, "enet initialization error\n");
+static i8 ServerFrame(const ArenaStats* stats, void* user) {
+    (void)user;
+    if (WindowShouldClose()) {
         return 1;
     }
 
-    atexit(enet_deinitialize);
+    BeginDrawing();
+    ClearBackground(GetColor(GuiGetStyle(DEFAULT, BACKGROUND_COLOR)));
+        DrawFPS(10, 10);
+        DrawProfOverlay(10, 35);
+        DrawText(TextFormat("SERVER RUNNING, %d PLAYERS, %d BODIES, %d AWAKE\nTICK %llu, %llu OVERRUNS\n%u CONTACTS, %s STEP\nQUEUES IN %u/%u OUT %u/%u, %u DROPPED\nWORST PEER %d, %u MS, %.1f%% LOSS\nLAST THING:\n%s", stats->players, stats->bodies, stats->awakeBodies, (unsigned long long)stats->ticks, (unsigned long long)stats->overruns, stats->contacts, stats->quickStep ? "QUICK" : "EXACT", stats->cmdQueueDepth, stats->cmdQueuePeak, stats->outQueueDepth, stats->outQueuePeak, stats->cmdOverflows + stats->outOverflows, stats->worstPeer, stats->worstRtt, stats->worstLoss * 100.f, Log_Last()), 100 + 50 * sinf(GetTime()), 100, 20, GetColor(GuiGetStyle(DEFAULT, TEXT_COLOR_NORMAL)));
+    EndDrawing();
+    return 0;
+}
 
-    const ENetAddress address = { .host = ENET_HOST_ANY, .port = 12345 };
-    host = enet_host_create(&address, MAX_PLAYERS, 2, 0, 0);
-    if (!host) {
-        TraceLog(LOG_ERROR, "server creation error\n");
+static i8 StartServer(void) {
+    const ArenaConfig config = ARENA_DEFAULT_CONFIG;
+    if (Arena_Run(&config, ServerFrame, NULL) != 0) {
         return 1;
     }
 
-    printf("Server started on port %u.\n", host->address.port);
-
-#ifdef _WIN32
-    struct ifaddrs* interfaces;
-    if (getifaddrs(&interfaces) == 0) {
-        printf("Server available on the following IP addresses:\n");
-        for (struct ifaddrs* ifa = interfaces; ifa != NULL; ifa = ifa->ifa_next) {
-            if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET) { // Only IPv4 addresses
-                char ip[INET_ADDRSTRLEN];
-                struct sockaddr_in* sockAddr = (struct sockaddr_in*)ifa->ifa_addr;
-                inet_ntop(AF_INET, &sockAddr->sin_addr, ip, INET_ADDRSTRLEN);
-                printf("  %s (%s)\n", ip, ifa->ifa_name);
-            }
-        }
-        freeifaddrs(interfaces);
-    } else {
-        perror("getifaddrs");
-    }
-#endif
-
-    dInitODE();
-    world = dWorldCreate();
-    dWorldSetGravity(world, 0.0, -9.8, 0.0);
-    space = dHashSpaceCreate(0);
-    contactGroup = dJointGroupCreate(0);
-
-    PeerInfo peerInfo[MAX_PLAYERS];
-    for (i32 i = 0; i < MAX_PLAYERS; i++) {
-        peerInfo[i].peer = NULL;
-        peerInfo[i].playerID = -1;
-    }
-
-    Body bodies[MAX_BODIES];
-    BodyState bodyStates[MAX_BODIES];
-    for (i32 i = 0; i < MAX_BODIES; i++) {
-        bodies[i].type = bodyStates[i].type = BODYTYPE_NULL;
-    }
-
-    // const Texture texture = LoadTexture("res/grassTexture.png");
-    // SetTextureFilter(texture, TEXTURE_FILTER_BILINEAR);
-
-    const i32 mainFloor = AddBodyMap(bodies, bodyStates, (Vector3){0.f, 0.f, 0.f}, (Vector3){0.f, 0.f, 0.f}, (Vector3){100.f, 1.f, 100.f}, DARKGRAY);
-    // bodies[mainFloor].display.materials->maps[MATERIAL_MAP_DIFFUSE].texture = texture;
-
-    AddBodyMap(bodies, bodyStates, (Vector3){4.f, 3.f, 0.f}, (Vector3){0.f, 0.f, -0.5f}, (Vector3){0.5f, 8.f, 12.f}, RED);
-    // AddBodyMap(bodies, bodyStates, (Vector3){-4.f, 3.f, 0.f}, (Vector3){0.f, 0.f, 0.5f}, (Vector3){0.5f, 8.f, 12.f}, YELLOW);
-    AddBodyMap(bodies, bodyStates, (Vector3){0.f, 3.f, 6.f}, (Vector3){0.f, 0.f, 0.f}, (Vector3){12.f, 8.f, 0.5f}, GREEN);
-    AddBodyMap(bodies, bodyStates, (Vector3){0.f, 3.f, -6.f}, (Vector3){0.f, 0.f, 0.f}, (Vector3){12.f, 8.f, 0.5f}, BLUE);
-
-    ENetEvent event;
-    const char* info = "Nothing has happened yet";
-    while (!WindowShouldClose()) {
-        BeginDrawing();
-        ClearBackground(GetColor(GuiGetStyle(DEFAULT, BACKGROUND_COLOR)));
-            DrawText(TextFormat("DOING NOTHING, LAST THING:\n%s", info), 100 + 50 * sinf(GetTime()), 100, 40, GetColor(GuiGetStyle(DEFAULT, TEXT_COLOR_NORMAL)));
-        EndDrawing();
-
-        while (enet_host_service(host, &event, 500) > 0) {
-            if (WindowShouldClose()) {
-                goto BREAK;
-            }
-            BeginDrawing();
-            ClearBackground(GetColor(GuiGetStyle(DEFAULT, BACKGROUND_COLOR)));
-                DrawFPS(10, 10);
-                DrawText(info, 100 + 50 * sinf(GetTime()), 100, 40, GetColor(GuiGetStyle(DEFAULT, TEXT_COLOR_NORMAL)));
-            EndDrawing();
-
-            static u8 playerUpdated = 0;
-            switch (event.type) {
-                case ENET_EVENT_TYPE_CONNECT: {
-                    info = TextFormat("A new client connected from %x:%u\n%s", event.peer->address.host, event.peer->address.port, info);
-                    u8 foundEmpty = 0;
-                    for (i32 i = 0; i < MAX_PLAYERS; i++) {
-                        if (players[i].id != -1) {
-                            continue;
-                        }
-
-                        peerInfo[i].peer = event.peer;
-                        peerInfo[i].playerID = players[i].id = i;
-                        players[i].pos = players[i].dir = (Vector3){0.f, 0.f, 0.f};
-
-                        MsgPlayerID idMsg = { .msg = MSGTYPE_C_PLAYER_ID, .playerID = i };
-                        ENetPacket* packet = enet_packet_create(&idMsg, sizeof(MsgPlayerID), ENET_PACKET_FLAG_RELIABLE);
-                        enet_peer_send(event.peer, 0, packet);
-
-                        info = TextFormat("Assigned ID: %d\n%s", i, info);
-
-                        foundEmpty = playerUpdated = 1;
-                        break;
-                    }
-                    if (!foundEmpty) {
-                        enet_peer_disconnect(event.peer, 0);
-                        info = TextFormat("Server full, disconnected client\n%s", info);
-                    }
-                } break;
-                case ENET_EVENT_TYPE_RECEIVE: {
-                    info = TextFormat("Packet received from client on channel %u\n", event.channelID);
-                    switch (*(MsgType*)event.packet->data) {
-                        case MSGTYPE_S_PLAYER_UPDATE: {
-                            const MsgPlayerUpdate* player = (MsgPlayerUpdate*)event.packet->data;
-                            players[player->player.id] = player->player;
-                            playerUpdated = 1;
-                            info = TextFormat("Updated player %d\n%s", player->player.id, info);
-                        } break;
-                        case MSGTYPE_S_NEW_BODY: {
-                            const MsgNewBody* body = (MsgNewBody*)event.packet->data;
-                            const BodyState state = body->body;
-                            const i32 id = AddBody(bodies, bodyStates, CMASK_OBJ, CMASK_OBJ | CMASK_MAP, state, 0);
-                        } break;
-                        default: {
-                            info = TextFormat("Unknown message type\n%s", info);
-                        } break;
-                    }
-                    enet_packet_destroy(event.packet);
-                } break;
-                case ENET_EVENT_TYPE_DISCONNECT: {
-                    for (i32 i = 0; i < MAX_PLAYERS; i++) {
-                        if (event.peer != peerInfo[i].peer) {
-                            continue;
-                        }
-                        players[i].id = peerInfo[i].playerID = -1;
-                        peerInfo[i].peer = NULL;
-                        playerUpdated = 1;
-                        info = TextFormat("Client disconnected");
-                        break;
-                    }
-                } break;
-                default: {
-                    info = TextFormat("Unknown event");
-                } break;
-            }
-
-            const f32 dt = GetFrameTime();
-
-            const f32 physicsTime = 1.f / 120.f;
-            static f32 physicsTimer = 0.f;
-            physicsTimer += dt;
-            while (physicsTimer >= physicsTime) {
-                dSpaceCollide(space, NULL, NearCallback);
-                dWorldStep(world, physicsTime);
-                dJointGroupEmpty(contactGroup);
-                physicsTimer -= physicsTime;
-            }
-
-            static f32 bodyBroadcastTimer = 0.f;
-            bodyBroadcastTimer += dt;
-            if (bodyBroadcastTimer >= BROADCAST_TIME) {
-                for (i32 i = 0; i < MAX_BODIES; i++) {
-                    if (BODYTYPE_NULL == bodies[i].type) {
-                        continue;
-                    }
-
-                    const dReal* pos;
-                    const dReal* rot;
-                    if (bodies[i].body) {
-                        pos = dBodyGetPosition(bodies[i].body);
-                        rot = dBodyGetRotation(bodies[i].body);
-                    } else {
-                        pos = dGeomGetPosition(bodies[i].geom);
-                        rot = dGeomGetRotation(bodies[i].geom);
-                    }
-
-                    GetTransformMat(bodyStates[i].transform, pos, rot);
-                }
-
-                MsgUpdateBodies updatedBodies = { .msg = MSGTYPE_C_UPDATE_BODIES };
-                memcpy(updatedBodies.bodies, bodyStates, sizeof(bodyStates));
-                ENetPacket* bodyPacket = enet_packet_create(&updatedBodies, sizeof(MsgUpdateBodies), ENET_PACKET_FLAG_RELIABLE);
-                enet_host_broadcast(host, 0, bodyPacket);
-
-                if (playerUpdated) { // TODO make players special bodies instead of floating cameras
-                    MsgUpdatePlayers updatedPlayers = { .msg = MSGTYPE_C_UPDATE_PLAYERS };
-                    memcpy(updatedPlayers.players, players, sizeof(players));
-                    ENetPacket* playerPacket = enet_packet_create(&updatedPlayers, sizeof(MsgUpdatePlayers), ENET_PACKET_FLAG_RELIABLE);
-                    enet_host_broadcast(host, 0, playerPacket);
-                    playerUpdated = 0;
-                }
-
-                bodyBroadcastTimer = 0.f;
-            }
-        }
-    }
-    BREAK:
-
-    enet_host_destroy(host);
-    for (i32 i = 0; i < MAX_BODIES; i++) {
-        if (bodies[i].body) {
-            dBodyDestroy(bodies[i].body);
-        }
-        dGeomDestroy(bodies[i].geom);
-    }
-    dJointGroupDestroy(contactGroup);
-    dWorldDestroy(world);
-    dCloseODE();
     CloseWindow();
     return 0;
 }
@@ -277,7 +82,7 @@ static u8 JoinServer(const i8* ip, const i8* port) {
 
     atexit(enet_deinitialize);
 
-    host = enet_host_create(NULL, 1, 2, 0, 0);
+    host = enet_host_create(NULL, 1, CHANNEL_COUNT, 0, 0);
     if (!host) {
         TraceLog(LOG_ERROR, "Error while trying to create the client host\n");
         return 1;
@@ -287,7 +92,7 @@ static u8 JoinServer(const i8* ip, const i8* port) {
     enet_address_set_host(&address, ip);
     address.port = atoi(port);
 
-    peer = enet_host_connect(host, &address, 2, 0); // 2 channels
+    peer = enet_host_connect(host, &address, CHANNEL_COUNT, PROTOCOL_VERSION);
     if (!peer) {
         TraceLog(LOG_ERROR, "No available peers for initiating an enet connection\n");
         return 1;
@@ -306,7 +111,7 @@ static void DrawScene(RenderBody* bodies) {
         DrawModel(bodies[i].display, (Vector3){0.f, 0.f, 0.f}, 1.f, bodies[i].state.col);
     }
 
-    for (i32 i = 0; i < MAX_PLAYERS; i++) {
+    for (i32 i = 0; i < playerCapacity; i++) {
         if (i == localID || -1 == players[i].id) {
             continue;
         }
@@ -327,16 +132,18 @@ i32 main(void) {
 
     randState = (u32)time(NULL);
 
-    for (i32 i = 0; i < MAX_PLAYERS; i++) {
-        players[i].id = -1;
-        players[i].pos = players[i].dir = (Vector3){0.f, 0.f, 0.f};
-    }
-
     RenderBody bodies[MAX_BODIES];
     for (i32 i = 0; i < MAX_BODIES; i++) {
         bodies[i].state.type = BODYTYPE_NULL;
+        bodies[i].state.isStatic = 0;
     }
 
+    // set up once the server sends its quantization bounds and tick rate
+    SnapReceiver snapReceiver = {0};
+    InterpBuffer interp = {0};
+    BodyState* sampled = NULL;
+    MsgUpdatePlayers updateMsg = {0};
+
     shadowShader = LoadShader("res/shadowMap.vert", "res/shadowMap.frag");
     shadowShader.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(shadowShader, "viewPos");
     const i32 lightDirLoc = GetShaderLocation(shadowShader, "lightDir");
@@ -417,48 +224,115 @@ i32 main(void) {
         while (enet_host_service(host, &event, 6) > 0) {
             switch (event.type) {
                 case ENET_EVENT_TYPE_RECEIVE: {
-                    switch (*(MsgType*)event.packet->data) {
+                    const u8* data = event.packet->data;
+                    const size_t len = event.packet->dataLength;
+                    switch (Msg_Type(data, len)) {
                         case MSGTYPE_C_PLAYER_ID: {
-                            if (-1 != localID) {
+                            MsgPlayerID idMsg;
+                            if (-1 != localID || Msg_ReadPlayerID(data, len, &idMsg) != 0) {
                                 break;
                             }
-                            const MsgPlayerID* idMsg = (MsgPlayerID*)event.packet->data;
-                            const i32 id = idMsg->playerID;
+                            // sized by the server, it may take far more players than are ever drawn
+                            players = malloc(sizeof(PlayerState) * idMsg.maxPlayers);
+                            updateMsg.slots = malloc(sizeof(i32) * idMsg.maxPlayers);
+                            updateMsg.players = malloc(sizeof(PlayerState) * idMsg.maxPlayers);
+                            if (!players || !updateMsg.slots || !updateMsg.players) {
+                                TraceLog(LOG_ERROR, "Couldn't allocate %d players\n", idMsg.maxPlayers);
+                                break;
+                            }
+                            playerCapacity = updateMsg.capacity = idMsg.maxPlayers;
+                            for (i32 i = 0; i < playerCapacity; i++) {
+                                players[i].id = -1;
+                            }
+
+                            sampled = malloc(sizeof(BodyState) * MAX_BODIES);
+                            if (!sampled || Snapshot_ReceiverInit(&snapReceiver, MAX_BODIES, idMsg.snapshotHistory, idMsg.bounds) != 0) {
+                                TraceLog(LOG_ERROR, "Couldn't allocate the snapshot history\n");
+                                break;
+                            }
+                            if (Interp_Init(&interp, MAX_BODIES, idMsg.tickTime, INTERP_MIN_DELAY) != 0) {
+                                TraceLog(LOG_ERROR, "Couldn't allocate the interpolation buffer\n");
+                                Snapshot_ReceiverFree(&snapReceiver);
+                                break;
+                            }
+                            const i32 id = idMsg.playerID;
+                            Move_Spawn(&players[id]);
                             players[id].id = localID = id;
+                            Move_PredictorInit(&predictor, &players[id]);
                             printf("RECEIVED ID: %d\n", id);
                         } break;
                         case MSGTYPE_C_UPDATE_PLAYERS: {
-                            const MsgUpdatePlayers* updateMsg = (MsgUpdatePlayers*)event.packet->data;
-                            for (i32 i = 0; i < MAX_PLAYERS; i++) {
-                                if (i != localID) {
-                                    players[i] = updateMsg->players[i];
+                            if (-1 == localID || Msg_ReadUpdatePlayers(data, len, &updateMsg) != 0) {
+                                break;
+                            }
+                            if (updateMsg.full) {
+                                for (i32 i = 0; i < playerCapacity; i++) {
+                                    if (i != localID) {
+                                        players[i].id = -1;
+                                    }
                                 }
                             }
+                            for (i32 i = 0; i < updateMsg.count; i++) {
+                                const i32 slot = updateMsg.slots[i];
+                                if (slot != localID) {
+                                    players[slot] = updateMsg.players[i];
+                                } else if (-1 != updateMsg.players[i].id) {
+                                    Move_Reconcile(&predictor, &updateMsg.players[i]);
+                                }
+                            }
+                        } break;
+                        case MSGTYPE_C_SNAPSHOT: {
+                            if (-1 == localID) {
+                                break;
+                            }
+                            PROF_BEGIN(PROF_SNAPSHOT_DECODE);
+                            const u32 seq = Snapshot_Decode(&snapReceiver, data, len);
+                            PROF_END(PROF_SNAPSHOT_DECODE);
+                            if (0 == seq) {
+                                break;
+                            }
+
+                            // acks are cumulative so losing one just means the next snapshot is a bit bigger
+                            u8 ackBuf[MSG_MAX_SIZE];
+                            const size_t ackLen = Msg_WriteSnapshotAck(ackBuf, sizeof(ackBuf), &(MsgSnapshotAck){ .seq = seq });
+                            enet_peer_send(peer, CHANNEL_STATE, enet_packet_create(ackBuf, ackLen, 0));
+
+                            // drawn from the interpolation buffer below rather than straight away
+                            Interp_Push(&interp, Snapshot_Latest(&snapReceiver), snapReceiver.latestTick, GetTime());
                         } break;
-                        case MSGTYPE_C_UPDATE_BODIES: {
-                            const MsgUpdateBodies* updateMsg = (MsgUpdateBodies*)event.packet->data;
+                        case MSGTYPE_C_LEVEL_LOAD: {
+                            BodyState* level = malloc(sizeof(BodyState) * MAX_BODIES);
+                            if (!level) {
+                                break;
+                            }
                             for (i32 i = 0; i < MAX_BODIES; i++) {
-                                if (BODYTYPE_NULL == bodies[i].state.type && BODYTYPE_NULL != updateMsg->bodies[i].type) {
-                                    const Vector3 s = updateMsg->bodies[i].size;
-                                    switch (updateMsg->bodies[i].type) {
-                                        case BODYTYPE_BOX: {
-                                            bodies[i].display = LoadModelFromMesh(GenMeshCube(s.x, s.y, s.z));
-                                        } break;
-                                        case BODYTYPE_SPHERE: {
-                                            bodies[i].display = LoadModelFromMesh(GenMeshSphere(s.x, 16, 16));
-                                        } break;
-                                        case BODYTYPE_NULL: break; // can't happen
+                                level[i].type = BODYTYPE_NULL;
+                            }
+
+                            if (Snapshot_DecodeLevel(level, MAX_BODIES, data, len) < 0) {
+                                TraceLog(LOG_WARNING, "Malformed level message\n");
+                            } else {
+                                for (i32 i = 0; i < MAX_BODIES; i++) {
+                                    if (BODYTYPE_NULL != level[i].type) {
+                                        SetBody(bodies, i, &level[i]);
                                     }
-                                    bodies[i].display.materials[0].shader = shadowShader;
                                 }
-
-                                bodies[i].state = updateMsg->bodies[i];
                             }
+                            free(level);
                         } break;
                         default: break;
                     }
                     enet_packet_destroy(event.packet);
                 } break;
+                case ENET_EVENT_TYPE_DISCONNECT: {
+                    if (DISCONNECT_VERSION == event.data) {
+                        TraceLog(LOG_ERROR, "Server runs a different protocol version, this client has %d\n", PROTOCOL_VERSION);
+                    } else if (DISCONNECT_FULL == event.data) {
+                        TraceLog(LOG_ERROR, "Server is full\n");
+                    } else if (DISCONNECT_SERVER_ERROR == event.data) {
+                        TraceLog(LOG_ERROR, "Server couldn't add this player\n");
+                    }
+                } break;
                 default: {
                     printf("UNKNOWN EVENT\n");
                 } break;
@@ -473,16 +347,32 @@ i32 main(void) {
             continue;
         }
 
-        Player_UpdateLocal(2.f, 2.f, deltaTime);
+        if (Interp_Sample(&interp, GetTime(), sampled)) {
+            for (i32 i = 0; i < MAX_BODIES; i++) {
+                if (bodies[i].state.isStatic) {
+                    continue; // owned by the level message, snapshots never mention it
+                }
+                if (BODYTYPE_NULL == sampled[i].type) {
+                    ReleaseBody(bodies, i);
+                    continue;
+                }
+                SetBody(bodies, i, &sampled[i]);
+            }
+        }
+
+        Player_UpdateLocal(&predictor, deltaTime);
 
-        static f32 playerBroadcastTimer = 0.f;
-        playerBroadcastTimer += deltaTime;
-        if (playerBroadcastTimer >= BROADCAST_TIME) {
-            MsgPlayerUpdate msg = { .msg = MSGTYPE_S_PLAYER_UPDATE, .player = players[localID] };
-            ENetPacket* packet = enet_packet_create(&msg, sizeof(MsgPlayerUpdate), ENET_PACKET_FLAG_RELIABLE);
-            enet_peer_send(peer, 0, packet);
+        static f32 inputSendTimer = 0.f;
+        inputSendTimer += deltaTime;
+        if (inputSendTimer >= INPUT_SEND_TIME) {
+            MsgPlayerInput inputMsg;
+            while ((inputMsg.count = Move_NextInputs(&predictor, inputMsg.inputs, MOVE_MAX_INPUTS)) > 0) {
+                u8 buf[MSG_MAX_SIZE];
+                const size_t len = Msg_WritePlayerInput(buf, sizeof(buf), &inputMsg);
+                enet_peer_send(peer, CHANNEL_STATE, enet_packet_create(buf, len, 0));
+            }
 
-            playerBroadcastTimer = 0.f;
+            inputSendTimer = 0.f;
         }
 
         const Vector3 camPos = playerCam.position;
@@ -533,6 +423,7 @@ i32 main(void) {
         }
 
         Matrix lightView, lightProj;
+        PROF_BEGIN(PROF_SHADOW_PASS);
         BeginTextureMode(shadowMap);
         ClearBackground(WHITE);
         BeginMode3D(lightCam);
@@ -541,6 +432,7 @@ i32 main(void) {
             DrawScene(bodies);
         EndMode3D();
         EndTextureMode();
+        PROF_END(PROF_SHADOW_PASS);
 
         const Matrix lightViewProj = MatrixMultiply(lightView, lightProj);
         SetShaderValueMatrix(shadowShader, lightVPLoc, lightViewProj);
@@ -577,7 +469,9 @@ i32 main(void) {
                     rlPopMatrix();
                 }
             } else {
+                PROF_BEGIN(PROF_DRAW_SCENE);
                 DrawScene(bodies);
+                PROF_END(PROF_DRAW_SCENE);
             }
             DrawSphere(lightCam.position, 1.f, lightColor);
             DrawSphereWires(lightCam.position, 1.f, 10, 10, BLACK);
@@ -591,77 +485,22 @@ i32 main(void) {
             DrawTextureEx(shadowMap.depth, (Vector2){0, 0}, 0.f, 0.6f, WHITE);
         }
         DrawFPS(10, 10);
+        DrawProfOverlay(10, 35);
         EndDrawing();
+        Prof_FrameEnd();
     }
 
+    Snapshot_ReceiverFree(&snapReceiver);
+    Interp_Free(&interp);
+    free(sampled);
+    free(players);
+    free(updateMsg.slots);
+    free(updateMsg.players);
     UnloadShadowmapRenderTexture(shadowMap);
     CloseWindow();
     return 0;
 }
 
-static inline void GetTransformMat(dReal res[16], const dReal* pos, const dReal* rot) {
-    res[0] = rot[0];
-    res[1] = rot[4];
-    res[2] = rot[8];
-    res[3] = 0.0;
-
-    res[4] = rot[1];
-    res[5] = rot[5];
-    res[6] = rot[9];
-    res[7] = 0.0;
-
-    res[8] = rot[2];
-    res[9] = rot[6];
-    res[10] = rot[10];
-    res[11] = 0.0;
-
-    res[12] = pos[0];
-    res[13] = pos[1];
-    res[14] = pos[2];
-    res[15] = 1.0;
-}
-
-static inline void GetTransformMatV(dReal res[16], Vector3 pos, Vector3 rot) {
-    const dReal cx = cos(rot.x);
-    const dReal sx = sin(rot.x);
-    const dReal cy = cos(rot.y);
-    const dReal sy = sin(rot.y);
-    const dReal cz = cos(rot.z);
-    const dReal sz = sin(rot.z);
-
-    res[0] = cy * cz;
-    res[1] = cz * sx * sy - cx * sz;
-    res[2] = cx * cz * sy + sx * sz;
-    res[3] = 0.0;
-
-    res[4] = cy * sz;
-    res[5] = cx * cz + sx * sy * sz;
-    res[6] = -cz * sx + cx * sy * sx;
-    res[7] = 0.0;
-
-    res[8] = -sy;
-    res[9] = cy * sx;
-    res[10] = cx * cy;
-    res[11] = 0.0;
-
-    res[12] = pos.x;
-    res[13] = pos.y;
-    res[14] = pos.z;
-    res[15] = 1.0;
-}
-
-static inline void GetTransMatPos(dReal res[3], const dReal trans[16]) {
-    res[0] = trans[12];
-    res[1] = trans[13];
-    res[2] = trans[14];
-}
-
-static inline void GetTransMatRot(dReal res[12], const dReal trans[16]) {
-    for (i32 i = 0; i < 12; i++) {
-        res[i] = trans[i];
-    }
-}
-
 static inline Matrix GetRLFromODEMat(const dReal mat[16]) {
     return (Matrix){
         .m0  = mat[0],   .m1 = mat[1],  .m2  = mat[2],  .m3  = mat[3],
@@ -671,93 +510,48 @@ static inline Matrix GetRLFromODEMat(const dReal mat[16]) {
     };
 }
 
-static void NearCallback(void* data, dGeomID o1, dGeomID o2) {
-    const i32 MAX_CONTACTS = 8;
-    dContact contacts[MAX_CONTACTS];
+// F3 hides it, F4 starts and stops a trace capture
+static void DrawProfOverlay(i32 x, i32 y) {
+    static i8 hidden = 0;
+    if (IsKeyPressed(KEY_F3)) {
+        hidden = !hidden;
+    }
+    if (IsKeyPressed(KEY_F4)) {
+        Prof_ToggleCapture();
+    }
 
-    const i32 nc = dCollide(o1, o2, MAX_CONTACTS, &contacts[0].geom, sizeof(dContact));
-    if (nc <= 0) {
+    if (Prof_Capturing()) {
+        DrawText("TRACING", x, y, 20, RED);
+        y += 22;
+    }
+    if (hidden) {
         return;
     }
-
-    for (i32 i = 0; i < nc; i++) {
-        contacts[i].surface.mode = dContactBounce; // Enable bounce
-        contacts[i].surface.bounce = 0.2;          // Bounce factor
-        contacts[i].surface.bounce_vel = 0.1;      // Minimum velocity for bounce
-        contacts[i].surface.mu = dInfinity;        // Friction coefficient
-
-        // Create a contact joint to handle the collision
-        dJointID c = dJointCreateContact(world, contactGroup, &contacts[i]);
-        dJointAttach(c, dGeomGetBody(o1), dGeomGetBody(o2));
+    for (i32 i = 0; i < PROF_ZONE_COUNT; i++) {
+        if (0.0 == Prof_Average(i)) {
+            continue; // zones that belong to the other side
+        }
+        DrawText(TextFormat("%-16s %6.3f MS x%u", Prof_ZoneName(i), Prof_Average(i), Prof_Calls(i)), x, y, 10, LIME);
+        y += 12;
     }
 }
 
-static i32 AddBody(Body* bodies, BodyState* states, CollMask category, CollMask collide, BodyState state, i8 isKinematic) {
-    for (i32 i = 0; i < MAX_BODIES; i++) {
-        if (bodies[i].type != BODYTYPE_NULL) {
-            continue;
-        }
-
-        Body* body = &bodies[i];
-        body->type = state.type;
-        body->body = dBodyCreate(world);
-
-        dReal pos[3], rm[12];
-        GetTransMatPos(pos, state.transform);
-        GetTransMatRot(rm, state.transform);
-        dBodySetPosition(body->body, pos[0], pos[1], pos[2]);
-        dBodySetRotation(body->body, rm);
-
-        if (isKinematic) {
-            dBodySetKinematic(body->body);
-        }
-
-        switch (state.type) {
-            case BODYTYPE_SPHERE: {
-                body->geom = dCreateSphere(space, state.size.x);
-            } break;
+static void SetBody(RenderBody* bodies, i32 id, const BodyState* state) {
+    if (BODYTYPE_NULL == bodies[id].state.type) {
+        const Vector3 s = state->size;
+        switch (state->type) {
             case BODYTYPE_BOX: {
-                body->geom = dCreateBox(space, state.size.x, state.size.y, state.size.z);
+                bodies[id].display = LoadModelFromMesh(GenMeshCube(s.x, s.y, s.z));
             } break;
-            default: return -1;
-        }
-        dGeomSetCategoryBits(body->geom, category);
-        dGeomSetCollideBits(body->geom, collide);
-        dGeomSetBody(body->geom, body->body);
-
-        states[i] = state;
-        return i;
-    }
-
-    return -1;
-}
-
-static i32 AddBodyMap(Body* bodies, BodyState* states, Vector3 pos, Vector3 rot, Vector3 size, Color col) {
-    for (i32 i = 0; i < MAX_BODIES; i++) {
-        if (bodies[i].type != BODYTYPE_NULL) {
-            continue;
+            case BODYTYPE_SPHERE: {
+                bodies[id].display = LoadModelFromMesh(GenMeshSphere(s.x, 16, 16));
+            } break;
+            case BODYTYPE_NULL: return;
         }
-
-        Body* body = &bodies[i];
-        body->type = BODYTYPE_BOX;
-        body->geom = dCreateBox(space, size.x, size.y, size.z);
-
-        dReal trans[16], rm[12];
-        GetTransformMatV(trans, pos, rot);
-        GetTransMatRot(rm, trans);
-        dGeomSetPosition(body->geom, pos.x, pos.y, pos.z);
-        dGeomSetRotation(body->geom, rm);
-
-        dGeomSetCategoryBits(body->geom, CMASK_MAP);
-        dGeomSetCategoryBits(body->geom, CMASK_ALL & ~CMASK_MAP);
-        body->body = NULL;
-
-        states[i] = (BodyState){ .size = size, .col = col, .type = BODYTYPE_BOX };
-        memcpy(states[i].transform, trans, sizeof(dReal) * 16);
-        return i;
+        bodies[id].display.materials[0].shader = shadowShader;
     }
 
-    return -1;
+    bodies[id].state = *state;
 }
 
 static void ReleaseBody(RenderBody* bodies, i32 id) {
@@ -770,9 +564,9 @@ static void ReleaseBody(RenderBody* bodies, i32 id) {
 }
 
 static void ClientAddBody(BodyState body) {
-    MsgNewBody msg = { .msg = MSGTYPE_S_NEW_BODY, .body = body };
-    ENetPacket* packet = enet_packet_create(&msg, sizeof(MsgNewBody), ENET_PACKET_FLAG_RELIABLE);
-    enet_peer_send(peer, 0, packet);
+    u8 buf[MSG_MAX_SIZE];
+    const size_t len = Msg_WriteNewBody(buf, sizeof(buf), &(MsgNewBody){ .body = body });
+    enet_peer_send(peer, CHANNEL_RELIABLE, enet_packet_create(buf, len, ENET_PACKET_FLAG_RELIABLE));
 }
 
 static RenderTexture LoadShadowmapRenderTexture(i32 width, i32 height) {
@@ -0,0 +1,139 @@
+#include "../inc/move.h"
+
+void Move_Spawn(PlayerState* p) {
+    p->pos = (Vector3){0.f, 2.f, -3.f};
+    p->yaw = p->pitch = 0.f;
+    p->sprint = 1.f;
+    p->lastInput = 0;
+    p->dir = Move_Direction(p->yaw, p->pitch);
+}
+
+void Move_Simulate(PlayerState* p, const PlayerInput* in) {
+    f32 speed = MOVE_SPEED;
+    if (in->buttons & INPUT_SPRINT) {
+        p->sprint += MOVE_DT;
+        speed += p->sprint * 10.f;
+    } else {
+        p->sprint = 1.f;
+    }
+
+    const f32 step = speed * MOVE_DT;
+    const f32 forwardMove = ((in->buttons & INPUT_FORWARD) ? step : 0.f) - ((in->buttons & INPUT_BACK) ? step : 0.f);
+    const f32 rightMove = ((in->buttons & INPUT_LEFT) ? step : 0.f) - ((in->buttons & INPUT_RIGHT) ? step : 0.f);
+    const f32 upMove = ((in->buttons & INPUT_UP) ? step : 0.f) - ((in->buttons & INPUT_DOWN) ? step : 0.f);
+
+    // the angles come from the client as they are, the pitch clamp is built into the packing
+    p->yaw = Quant_UnpackYaw(in->yaw);
+    p->pitch = Quant_UnpackPitch(in->pitch, MOVE_MAX_PITCH);
+
+    // up cross forward, normalized, pitch is clamped so the length never hits 0
+    const Vector3 forward = Move_Direction(p->yaw, p->pitch);
+    const f32 flat = sqrtf(forward.x * forward.x + forward.z * forward.z);
+    const Vector3 right = { forward.z / flat, 0.f, -forward.x / flat };
+
+    p->pos.x += forward.x * forwardMove + right.x * rightMove;
+    p->pos.y += forward.y * forwardMove + upMove;
+    p->pos.z += forward.z * forwardMove + right.z * rightMove;
+    p->dir = forward;
+}
+
+static i8 SameState(const PlayerState* a, const PlayerState* b) {
+    return a->pos.x == b->pos.x && a->pos.y == b->pos.y && a->pos.z == b->pos.z &&
+        a->yaw == b->yaw && a->pitch == b->pitch && a->sprint == b->sprint;
+}
+
+void Move_PredictorInit(MovePredictor* m, const PlayerState* start) {
+    m->nextSeq = 1;
+    m->sentSeq = m->ackedSeq = 0;
+    m->state = m->prev = *start;
+    m->accumulator = 0.f;
+}
+
+f32 Move_Predict(MovePredictor* m, u16 buttons, f32 yaw, f32 pitch, f32 dt) {
+    const PlayerInput input = { .buttons = buttons, .yaw = Quant_PackYaw(yaw), .pitch = Quant_PackPitch(pitch, MOVE_MAX_PITCH) };
+
+    m->accumulator += dt;
+    while (m->accumulator >= MOVE_DT) {
+        m->accumulator -= MOVE_DT;
+
+        // the history is full when the server stops answering, the oldest input
+        // is dropped and a correction that needs it will just snap instead
+        const u32 seq = m->nextSeq++;
+        PlayerInput* in = &m->inputs[seq % MOVE_HISTORY];
+        *in = input;
+        in->seq = seq;
+        m->prev = m->state;
+        Move_Simulate(&m->state, in);
+        m->state.lastInput = seq;
+
+        // with everything before it acked the server is exactly here too, so an input
+        // that changes nothing would change nothing there either and needn't be sent
+        if (m->ackedSeq + 1 == seq && SameState(&m->prev, &m->state)) {
+            m->ackedSeq = m->sentSeq = seq;
+        }
+    }
+    return m->accumulator / MOVE_DT;
+}
+
+i32 Move_NextInputs(MovePredictor* m, PlayerInput* res, i32 max) {
+    // anything that fell out of the history is gone, send from the oldest still there
+    const u32 oldest = m->nextSeq > MOVE_HISTORY ? m->nextSeq - MOVE_HISTORY : 1;
+    if (m->sentSeq + 1 < oldest) {
+        m->sentSeq = oldest - 1;
+    }
+    if (m->sentSeq + 1 >= m->nextSeq) {
+        return 0;
+    }
+
+    const u32 last = m->sentSeq + max < m->nextSeq ? m->sentSeq + max : m->nextSeq - 1;
+    u32 first = last + 1 - max;
+    if (last < (u32)max || first <= m->ackedSeq) {
+        first = m->ackedSeq + 1;
+    }
+    if (first < oldest) {
+        first = oldest;
+    }
+
+    i32 count = 0;
+    for (u32 seq = first; seq <= last; seq++) {
+        res[count++] = m->inputs[seq % MOVE_HISTORY];
+    }
+    m->sentSeq = last;
+    return count;
+}
+
+void Move_Reconcile(MovePredictor* m, const PlayerState* server) {
+    // the state channel is sequenced but that doesn't cover a server that jumped back
+    if (server->lastInput < m->ackedSeq || server->lastInput >= m->nextSeq) {
+        return;
+    }
+    m->ackedSeq = server->lastInput;
+
+    u32 seq = m->ackedSeq + 1;
+    if (m->nextSeq - seq > MOVE_HISTORY) {
+        seq = m->nextSeq - MOVE_HISTORY;
+    }
+
+    // replaying with the same inputs lands exactly where the prediction was unless
+    // the server disagreed, so drawing prev -> state stays smooth when nothing went wrong
+    PlayerState state = *server;
+    m->prev = state;
+    i8 leading = seq == m->ackedSeq + 1;
+    for (; seq < m->nextSeq; seq++) {
+        m->prev = state;
+        Move_Simulate(&state, &m->inputs[seq % MOVE_HISTORY]);
+        state.lastInput = seq;
+
+        // idle inputs that were still in flight count as acked the same way new ones do in
+        // Move_Predict, otherwise stopping would keep sending until the acks catch up, forever
+        leading = leading && SameState(&m->prev, &state);
+        if (leading) {
+            m->ackedSeq = seq;
+        }
+    }
+    if (m->sentSeq < m->ackedSeq) {
+        m->sentSeq = m->ackedSeq;
+    }
+    state.id = m->state.id;
+    m->state = state;
+}
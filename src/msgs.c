@@ -0,0 +1,307 @@
+#include <math.h>
+
+#include "../inc/msgs.h"
+#include "../inc/bits.h"
+#include "../inc/snapshot.h"
+
+static const i32 rotIndices[9] = { 0, 1, 2, 4, 5, 6, 8, 9, 10 };
+
+i32 Msg_Type(const u8* data, size_t len) {
+    if (0 == len || data[0] >= MSGTYPE_COUNT) {
+        return -1;
+    }
+    return data[0];
+}
+
+const i8* Msg_TypeName(i32 type) {
+    static const i8* names[MSGTYPE_COUNT] = {
+        [MSGTYPE_C_PLAYER_ID] = "player_id",
+        [MSGTYPE_C_UPDATE_PLAYERS] = "update_players",
+        [MSGTYPE_S_PLAYER_INPUT] = "player_input",
+        [MSGTYPE_C_SNAPSHOT] = "snapshot",
+        [MSGTYPE_S_NEW_BODY] = "new_body",
+        [MSGTYPE_S_SNAPSHOT_ACK] = "snapshot_ack",
+        [MSGTYPE_C_LEVEL_LOAD] = "level_load",
+        [MSGTYPE_C_SERVER_STATS] = "server_stats"
+    };
+    return type >= 0 && type < MSGTYPE_COUNT && names[type] ? names[type] : "unknown";
+}
+
+static i8 ReadHeader(BitReader* r, const u8* data, size_t len, MsgType type) {
+    Bits_ReaderInit(r, data, len);
+    return Bits_Read(r, MSGTYPE_BITS) == (u32)type && !r->failed;
+}
+
+static size_t Finish(const BitWriter* w) {
+    return w->overflow ? 0 : Bits_WriterBytes(w);
+}
+
+static void WriteVector3(BitWriter* w, Vector3 v) {
+    Bits_WriteF32(w, v.x);
+    Bits_WriteF32(w, v.y);
+    Bits_WriteF32(w, v.z);
+}
+
+static Vector3 ReadVector3(BitReader* r) {
+    Vector3 v;
+    v.x = Bits_ReadF32(r);
+    v.y = Bits_ReadF32(r);
+    v.z = Bits_ReadF32(r);
+    return v;
+}
+
+size_t Msg_WritePlayerID(u8* buf, size_t size, const MsgPlayerID* msg) {
+    BitWriter w;
+    Bits_WriterInit(&w, buf, size);
+    Bits_Write(&w, MSGTYPE_C_PLAYER_ID, MSGTYPE_BITS);
+    Bits_WriteRange(&w, msg->maxPlayers, 1, PLAYER_LIMIT);
+    Bits_WriteRange(&w, msg->playerID, 0, msg->maxPlayers - 1);
+    WriteVector3(&w, msg->bounds.min);
+    WriteVector3(&w, msg->bounds.max);
+    Bits_WriteF32(&w, msg->tickTime);
+    Bits_WriteRange(&w, msg->snapshotHistory, SNAPSHOT_MIN_HISTORY, SNAPSHOT_MAX_HISTORY);
+    return Finish(&w);
+}
+
+i8 Msg_ReadPlayerID(const u8* data, size_t len, MsgPlayerID* res) {
+    BitReader r;
+    if (!ReadHeader(&r, data, len, MSGTYPE_C_PLAYER_ID)) {
+        return 1;
+    }
+    res->maxPlayers = Bits_ReadRange(&r, 1, PLAYER_LIMIT);
+    res->playerID = Bits_ReadRange(&r, 0, res->maxPlayers - 1);
+    res->bounds.min = ReadVector3(&r);
+    res->bounds.max = ReadVector3(&r);
+    res->tickTime = Bits_ReadF32(&r);
+    res->snapshotHistory = Bits_ReadRange(&r, SNAPSHOT_MIN_HISTORY, SNAPSHOT_MAX_HISTORY);
+
+    const QuantBounds* b = &res->bounds;
+    return !Bits_ReaderDone(&r) || b->min.x >= b->max.x || b->min.y >= b->max.y || b->min.z >= b->max.z || res->tickTime <= 0.f;
+}
+
+void Msg_CollectPlayers(MsgUpdatePlayers* res, const PlayerState* players, const u32* dirty, u8 full) {
+    res->full = full;
+    res->count = 0;
+    for (i32 i = 0; i < res->capacity; i++) {
+        // a full update leaves empty slots out, their absence says they're empty
+        if (full ? -1 != players[i].id : PLAYER_MASK_HAS(dirty, i)) {
+            res->slots[res->count] = i;
+            res->players[res->count++] = players[i];
+        }
+    }
+}
+
+#define PLAYER_STATE_BITS (1 + 3 * 32 + 3 * 32 + 32)
+
+size_t Msg_UpdatePlayersMaxSize(i32 capacity) {
+    const size_t bits = MSGTYPE_BITS + 1 + Bits_Range(0, capacity) + (size_t)capacity * (Bits_Range(0, capacity - 1) + PLAYER_STATE_BITS);
+    return (bits + 7) / 8;
+}
+
+size_t Msg_WriteUpdatePlayers(u8* buf, size_t size, const MsgUpdatePlayers* msg) {
+    BitWriter w;
+    Bits_WriterInit(&w, buf, size);
+    Bits_Write(&w, MSGTYPE_C_UPDATE_PLAYERS, MSGTYPE_BITS);
+    Bits_Write(&w, msg->full, 1);
+    Bits_WriteRange(&w, msg->count, 0, msg->capacity);
+    for (i32 i = 0; i < msg->count; i++) {
+        const PlayerState* p = &msg->players[i];
+        Bits_WriteRange(&w, msg->slots[i], 0, msg->capacity - 1);
+        Bits_Write(&w, -1 != p->id, 1);
+        if (-1 != p->id) {
+            WriteVector3(&w, p->pos);
+            Bits_WriteF32(&w, p->yaw);
+            Bits_WriteF32(&w, p->pitch);
+            Bits_WriteF32(&w, p->sprint);
+            Bits_Write(&w, p->lastInput, 32);
+        }
+    }
+    return Finish(&w);
+}
+
+i8 Msg_ReadUpdatePlayers(const u8* data, size_t len, MsgUpdatePlayers* res) {
+    BitReader r;
+    if (!ReadHeader(&r, data, len, MSGTYPE_C_UPDATE_PLAYERS)) {
+        return 1;
+    }
+    res->full = Bits_Read(&r, 1);
+    res->count = Bits_ReadRange(&r, 0, res->capacity);
+
+    for (i32 i = 0; i < res->count && !r.failed; i++) {
+        const i32 slot = Bits_ReadRange(&r, 0, res->capacity - 1);
+        // increasing means no slot can be in it twice, which would make the order matter
+        if (i > 0 && slot <= res->slots[i - 1]) {
+            return 1;
+        }
+        res->slots[i] = slot;
+
+        PlayerState* p = &res->players[i];
+        if (Bits_Read(&r, 1)) {
+            p->id = slot;
+            p->pos = ReadVector3(&r);
+            p->yaw = Bits_ReadF32(&r);
+            p->pitch = Bits_ReadF32(&r);
+            p->sprint = Bits_ReadF32(&r);
+            p->lastInput = Bits_Read(&r, 32);
+            p->dir = Move_Direction(p->yaw, p->pitch);
+        } else {
+            *p = (PlayerState){ .id = -1 };
+        }
+    }
+    return !Bits_ReaderDone(&r);
+}
+
+// consecutive inputs mostly repeat the one before, so after the first each
+// one only has its buttons and angles if they changed
+size_t Msg_WritePlayerInput(u8* buf, size_t size, const MsgPlayerInput* msg) {
+    BitWriter w;
+    Bits_WriterInit(&w, buf, size);
+    Bits_Write(&w, MSGTYPE_S_PLAYER_INPUT, MSGTYPE_BITS);
+    Bits_WriteRange(&w, msg->count, 1, MOVE_MAX_INPUTS);
+    Bits_Write(&w, msg->inputs[msg->count - 1].seq, 32);
+    for (i32 i = 0; i < msg->count; i++) {
+        const PlayerInput* in = &msg->inputs[i];
+        const PlayerInput* prev = i > 0 ? &msg->inputs[i - 1] : NULL;
+
+        const u8 buttonsChanged = !prev || prev->buttons != in->buttons;
+        const u8 anglesChanged = !prev || prev->yaw != in->yaw || prev->pitch != in->pitch;
+        if (prev) {
+            Bits_Write(&w, buttonsChanged, 1);
+            Bits_Write(&w, anglesChanged, 1);
+        }
+        if (buttonsChanged) {
+            Bits_Write(&w, in->buttons, INPUT_BUTTON_BITS);
+        }
+        if (anglesChanged) {
+            Bits_Write(&w, in->yaw, QUANT_ANGLE_BITS);
+            Bits_Write(&w, in->pitch, QUANT_ANGLE_BITS);
+        }
+    }
+    return Finish(&w);
+}
+
+i8 Msg_ReadPlayerInput(const u8* data, size_t len, MsgPlayerInput* res) {
+    BitReader r;
+    if (!ReadHeader(&r, data, len, MSGTYPE_S_PLAYER_INPUT)) {
+        return 1;
+    }
+    res->count = Bits_ReadRange(&r, 1, MOVE_MAX_INPUTS);
+    const u32 newest = Bits_Read(&r, 32);
+    // seqs start at 1
+    if (r.failed || newest < (u32)res->count) {
+        return 1;
+    }
+
+    for (i32 i = 0; i < res->count; i++) {
+        PlayerInput* in = &res->inputs[i];
+        const PlayerInput* prev = i > 0 ? &res->inputs[i - 1] : NULL;
+
+        const u8 buttonsChanged = !prev || Bits_Read(&r, 1);
+        const u8 anglesChanged = !prev || Bits_Read(&r, 1);
+        in->seq = newest - (res->count - 1) + i;
+        in->buttons = buttonsChanged ? Bits_Read(&r, INPUT_BUTTON_BITS) : prev->buttons;
+        in->yaw = anglesChanged ? Bits_Read(&r, QUANT_ANGLE_BITS) : prev->yaw;
+        in->pitch = anglesChanged ? Bits_Read(&r, QUANT_ANGLE_BITS) : prev->pitch;
+    }
+    return !Bits_ReaderDone(&r);
+}
+
+size_t Msg_WriteNewBody(u8* buf, size_t size, const MsgNewBody* msg) {
+    const BodyState* b = &msg->body;
+    BitWriter w;
+    Bits_WriterInit(&w, buf, size);
+    Bits_Write(&w, MSGTYPE_S_NEW_BODY, MSGTYPE_BITS);
+    Bits_WriteRange(&w, b->type, BODYTYPE_SPHERE, BODYTYPE_BOX);
+    for (i32 i = 0; i < 3; i++) {
+        Bits_WriteF32(&w, b->transform[12 + i]);
+    }
+    for (i32 i = 0; i < 9; i++) {
+        Bits_WriteF32(&w, b->transform[rotIndices[i]]);
+    }
+    WriteVector3(&w, b->size);
+    Bits_Write(&w, b->col.r | b->col.g << 8 | b->col.b << 16 | (u32)b->col.a << 24, 32);
+    return Finish(&w);
+}
+
+// columns unit length and perpendicular, and a rotation rather than a reflection
+static i8 ValidRotation(const dReal trans[16]) {
+    const dReal* c[3] = { &trans[0], &trans[4], &trans[8] };
+    for (i32 i = 0; i < 3; i++) {
+        for (i32 j = i; j < 3; j++) {
+            const dReal dot = c[i][0] * c[j][0] + c[i][1] * c[j][1] + c[i][2] * c[j][2];
+            if (!(fabs(dot - (i == j)) <= MSG_ROT_TOLERANCE)) {
+                return 0;
+            }
+        }
+    }
+    const dReal det = c[0][0] * (c[1][1] * c[2][2] - c[1][2] * c[2][1]) - c[1][0] * (c[0][1] * c[2][2] - c[0][2] * c[2][1]) + c[2][0] * (c[0][1] * c[1][2] - c[0][2] * c[1][1]);
+    return det > 0.0;
+}
+
+i8 Msg_ReadNewBody(const u8* data, size_t len, const QuantBounds* bounds, MsgNewBody* res) {
+    BitReader r;
+    if (!ReadHeader(&r, data, len, MSGTYPE_S_NEW_BODY)) {
+        return 1;
+    }
+
+    BodyState* b = &res->body;
+    *b = (BodyState){0};
+    b->type = Bits_ReadRange(&r, BODYTYPE_SPHERE, BODYTYPE_BOX);
+    for (i32 i = 0; i < 3; i++) {
+        b->transform[12 + i] = Bits_ReadF32(&r);
+    }
+    for (i32 i = 0; i < 9; i++) {
+        b->transform[rotIndices[i]] = Bits_ReadF32(&r);
+    }
+    b->transform[15] = 1.0;
+    b->size = ReadVector3(&r);
+    const u32 col = Bits_Read(&r, 32);
+    b->col = (Color){ col & 0xff, col >> 8 & 0xff, col >> 16 & 0xff, col >> 24 };
+
+    if (!Bits_ReaderDone(&r)) {
+        return 1;
+    }
+
+    // ode asserts on zero or negative sizes, and anything huge or far away only costs the server
+    const dReal* pos = &b->transform[12];
+    const i8 inBounds = pos[0] >= bounds->min.x && pos[0] <= bounds->max.x && pos[1] >= bounds->min.y && pos[1] <= bounds->max.y && pos[2] >= bounds->min.z && pos[2] <= bounds->max.z;
+    return !Body_ValidSize(b->type, b->size, MAX_BODY_SIZE) || !inBounds || !ValidRotation(b->transform);
+}
+
+size_t Msg_WriteSnapshotAck(u8* buf, size_t size, const MsgSnapshotAck* msg) {
+    BitWriter w;
+    Bits_WriterInit(&w, buf, size);
+    Bits_Write(&w, MSGTYPE_S_SNAPSHOT_ACK, MSGTYPE_BITS);
+    Bits_Write(&w, msg->seq, 32);
+    return Finish(&w);
+}
+
+i8 Msg_ReadSnapshotAck(const u8* data, size_t len, MsgSnapshotAck* res) {
+    BitReader r;
+    if (!ReadHeader(&r, data, len, MSGTYPE_S_SNAPSHOT_ACK)) {
+        return 1;
+    }
+    res->seq = Bits_Read(&r, 32);
+    return !Bits_ReaderDone(&r);
+}
+
+size_t Msg_WriteServerStats(u8* buf, size_t size, const MsgServerStats* msg) {
+    BitWriter w;
+    Bits_WriterInit(&w, buf, size);
+    Bits_Write(&w, MSGTYPE_C_SERVER_STATS, MSGTYPE_BITS);
+    Bits_Write(&w, msg->tick, 32);
+    Bits_Write(&w, msg->overruns, 32);
+    Bits_Write(&w, msg->droppedTicks, 32);
+    return Finish(&w);
+}
+
+i8 Msg_ReadServerStats(const u8* data, size_t len, MsgServerStats* res) {
+    BitReader r;
+    if (!ReadHeader(&r, data, len, MSGTYPE_C_SERVER_STATS)) {
+        return 1;
+    }
+    res->tick = Bits_Read(&r, 32);
+    res->overruns = Bits_Read(&r, 32);
+    res->droppedTicks = Bits_Read(&r, 32);
+    return !Bits_ReaderDone(&r);
+}
@@ -0,0 +1,333 @@
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "enet/enet.h"
+
+#include "../inc/util.h"
+#include "../inc/log.h"
+#include "../inc/tick.h"
+#include "../inc/impair.h"
+
+// udp proxy that makes loopback behave like a bad connection. clients connect to
+// --listen instead of the server and everything is forwarded both ways through
+// impair.h, each direction on its own. only links enet:
+//   netsim [--listen 12346] [--server 127.0.0.1:12345] [--latency MS] [--jitter MS] [--loss PCT]
+//          [--dup PCT] [--reorder PCT] [--rate KBITS] [--queue MS] [--profile FILE] [--seed 1]
+//          [--report-interval 5] [--verbose]
+
+#define MAX_FLOWS 64
+#define FLOW_TIMEOUT 60.0    // seconds without a packet from the client before its flow is dropped
+#define MAX_WAIT 0.01        // longest select, so profile changes apply on time
+#define DATAGRAM_SIZE 65536
+
+// one client address and the socket it talks to the server through
+typedef struct flow {
+    ENetAddress client;
+    ENetSocket socket;
+    ImpairLink up;   // client -> server
+    ImpairLink down; // server -> client
+    f64 lastActive;
+} Flow;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void HandleSignal(i32 sig) {
+    (void)sig;
+    stopRequested = 1;
+}
+
+static void PrintUsage(const i8* exe) {
+    fprintf(stderr, "usage: %s [--listen PORT] [--server HOST:PORT] [--latency MS] [--jitter MS] [--loss PCT] [--dup PCT] [--reorder PCT] [--rate KBITS] [--queue MS] [--profile FILE] [--seed N] [--report-interval SECONDS] [--verbose]\n", exe);
+}
+
+static void AddStats(ImpairStats* res, const ImpairStats* s) {
+    res->packetsIn += s->packetsIn;
+    res->packetsOut += s->packetsOut;
+    res->bytesIn += s->bytesIn;
+    res->bytesOut += s->bytesOut;
+    res->lost += s->lost;
+    res->duplicated += s->duplicated;
+    res->reordered += s->reordered;
+    res->overflowed += s->overflowed;
+}
+
+static void LogDirection(const i8* dir, const ImpairStats* s, i32 queued) {
+    Log_Write(LOGLEVEL_INFO, "netsim_report", "dir=%s packets_in=%llu packets_out=%llu bytes_in=%llu bytes_out=%llu lost=%llu duplicated=%llu reordered=%llu overflowed=%llu queued=%d",
+        dir, (unsigned long long)s->packetsIn, (unsigned long long)s->packetsOut, (unsigned long long)s->bytesIn, (unsigned long long)s->bytesOut,
+        (unsigned long long)s->lost, (unsigned long long)s->duplicated, (unsigned long long)s->reordered, (unsigned long long)s->overflowed, queued);
+}
+
+static void LogSettings(const ImpairSettings* s, f64 time) {
+    Log_Write(LOGLEVEL_INFO, "netsim_settings", "time=%.2f latency_ms=%.1f jitter_ms=%.1f loss_pct=%.2f dup_pct=%.2f reorder_pct=%.2f rate_kbit=%.1f queue_ms=%.1f",
+        time, s->latency * 1000.0, s->jitter * 1000.0, s->loss * 100.0, s->duplicate * 100.0, s->reorder * 100.0, s->rate * 8.0 / 1000.0, s->queueTime * 1000.0);
+}
+
+static void FreeFlow(Flow* f) {
+    enet_socket_destroy(f->socket);
+    Impair_Free(&f->up);
+    Impair_Free(&f->down);
+}
+
+// drains everything that's due on one link out through socket to address
+static void Deliver(ImpairLink* l, ENetSocket socket, const ENetAddress* address, f64 now) {
+    ImpairPacket packet;
+    while (Impair_Pop(l, now, &packet)) {
+        const ENetBuffer buffer = { .data = packet.data, .dataLength = packet.len };
+        if (enet_socket_send(socket, address, &buffer, 1) < 0) {
+            Log_Write(LOGLEVEL_DEBUG, "send_failed", "host=%x port=%u len=%zu", address->host, address->port, packet.len);
+        }
+        free(packet.data);
+    }
+}
+
+i32 main(i32 argc, i8** argv) {
+    u16 listenPort = 12346;
+    const i8* serverHost = "127.0.0.1";
+    u16 serverPort = 12345;
+    const i8* profilePath = NULL;
+    u64 seed = 1;
+    f64 reportInterval = 5.0;
+    ImpairSettings base = IMPAIR_NONE;
+
+    static const i8* settingFlags[] = { "latency", "jitter", "loss", "dup", "reorder", "rate", "queue" };
+    i8 serverArg[256];
+    for (i32 i = 1; i < argc; i++) {
+        i8 handled = 0;
+        for (u32 k = 0; k < sizeof(settingFlags) / sizeof(settingFlags[0]) && !handled; k++) {
+            if (0 == strncmp(argv[i], "--", 2) && 0 == strcmp(argv[i] + 2, settingFlags[k]) && i + 1 < argc) {
+                if (Impair_ParseSetting(&base, settingFlags[k], argv[++i]) != 0) {
+                    PrintUsage(argv[0]);
+                    return 1;
+                }
+                handled = 1;
+            }
+        }
+        if (handled) {
+            continue;
+        }
+
+        if (0 == strcmp(argv[i], "--listen") && i + 1 < argc) {
+            listenPort = (u16)atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--server") && i + 1 < argc) {
+            i32 port;
+            if (2 != sscanf(argv[++i], "%255[^:]:%d", serverArg, &port) || port <= 0 || port > 65535) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            serverHost = serverArg;
+            serverPort = (u16)port;
+        } else if (0 == strcmp(argv[i], "--profile") && i + 1 < argc) {
+            profilePath = argv[++i];
+        } else if (0 == strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (0 == strcmp(argv[i], "--report-interval") && i + 1 < argc) {
+            reportInterval = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--verbose")) {
+            logMinLevel = LOGLEVEL_DEBUG;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (reportInterval <= 0.0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    ImpairProfile profile = { 0 };
+    if (profilePath && Impair_LoadProfile(&profile, profilePath, base) != 0) {
+        return 1;
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    if (enet_initialize() != 0) {
+        Log_Write(LOGLEVEL_ERROR, "enet_init_failed", "");
+        Impair_FreeProfile(&profile);
+        return 1;
+    }
+
+    ENetAddress server = { .port = serverPort };
+    const ENetAddress listenAddress = { .host = ENET_HOST_ANY, .port = listenPort };
+    const ENetSocket listenSocket = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+    if (enet_address_set_host(&server, serverHost) != 0 || ENET_SOCKET_NULL == listenSocket || enet_socket_bind(listenSocket, &listenAddress) != 0) {
+        Log_Write(LOGLEVEL_ERROR, "listen_failed", "port=%u server=%s:%u", listenPort, serverHost, serverPort);
+        if (ENET_SOCKET_NULL != listenSocket) {
+            enet_socket_destroy(listenSocket);
+        }
+        enet_deinitialize();
+        Impair_FreeProfile(&profile);
+        return 1;
+    }
+    enet_socket_set_option(listenSocket, ENET_SOCKOPT_NONBLOCK, 1);
+
+    Log_Write(LOGLEVEL_INFO, "netsim_start", "listen=%u server=%s:%u profile=%s steps=%d seed=%llu",
+        listenPort, serverHost, serverPort, profilePath ? profilePath : "none", profile.count, (unsigned long long)seed);
+
+    static Flow flows[MAX_FLOWS];
+    static u8 datagram[DATAGRAM_SIZE];
+    i32 flowCount = 0;
+    u32 flowsCreated = 0;
+    ImpairStats closedUp = { 0 }, closedDown = { 0 };
+
+    // the profile starts with the first packet rather than with the process, so
+    // a script that starts the server and clients afterwards still lines up with it
+    f64 profileStart = -1.0;
+    i32 lastStep = -1;
+    ImpairSettings settings = base;
+    LogSettings(&settings, 0.0);
+
+    f64 nextReport = Tick_Now() + reportInterval;
+    while (!stopRequested) {
+        f64 now = Tick_Now();
+
+        if (profileStart >= 0.0 && profile.count > 0) {
+            const f64 time = now - profileStart;
+            i32 step = -1;
+            while (step + 1 < profile.count && profile.steps[step + 1].time <= time) {
+                step++;
+            }
+            if (step != lastStep) {
+                lastStep = step;
+                settings = Impair_ProfileAt(&profile, time, base);
+                for (i32 i = 0; i < flowCount; i++) {
+                    flows[i].up.settings = flows[i].down.settings = settings;
+                }
+                LogSettings(&settings, time);
+            }
+        }
+
+        for (i32 i = 0; i < flowCount; i++) {
+            Deliver(&flows[i].up, flows[i].socket, &server, now);
+            Deliver(&flows[i].down, listenSocket, &flows[i].client, now);
+        }
+
+        f64 wake = now + MAX_WAIT;
+        ENetSocketSet readSet;
+        ENET_SOCKETSET_EMPTY(readSet);
+        ENET_SOCKETSET_ADD(readSet, listenSocket);
+        ENetSocket maxSocket = listenSocket;
+        for (i32 i = 0; i < flowCount; i++) {
+            const f64 up = Impair_NextDue(&flows[i].up);
+            const f64 down = Impair_NextDue(&flows[i].down);
+            wake = up >= 0.0 ? fmin(wake, up) : wake;
+            wake = down >= 0.0 ? fmin(wake, down) : wake;
+            ENET_SOCKETSET_ADD(readSet, flows[i].socket);
+            maxSocket = flows[i].socket > maxSocket ? flows[i].socket : maxSocket;
+        }
+
+        const f64 wait = wake - now;
+        if (enet_socketset_select(maxSocket, &readSet, NULL, wait > 0.0 ? (enet_uint32)ceil(wait * 1000.0) : 0) <= 0) {
+            ENET_SOCKETSET_EMPTY(readSet);
+        }
+        now = Tick_Now();
+
+        if (ENET_SOCKETSET_CHECK(readSet, listenSocket)) {
+            for (;;) {
+                ENetAddress from;
+                ENetBuffer buffer = { .data = datagram, .dataLength = sizeof(datagram) };
+                const i32 len = enet_socket_receive(listenSocket, &from, &buffer, 1);
+                if (len <= 0) {
+                    break;
+                }
+
+                Flow* f = NULL;
+                for (i32 i = 0; i < flowCount && !f; i++) {
+                    if (flows[i].client.host == from.host && flows[i].client.port == from.port) {
+                        f = &flows[i];
+                    }
+                }
+                if (!f) {
+                    if (MAX_FLOWS == flowCount) {
+                        Log_Write(LOGLEVEL_WARN, "too_many_flows", "host=%x port=%u", from.host, from.port);
+                        continue;
+                    }
+                    const ENetAddress any = { .host = ENET_HOST_ANY, .port = 0 };
+                    const ENetSocket socket = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+                    if (ENET_SOCKET_NULL == socket || enet_socket_bind(socket, &any) != 0) {
+                        Log_Write(LOGLEVEL_ERROR, "flow_socket_failed", "host=%x port=%u", from.host, from.port);
+                        if (ENET_SOCKET_NULL != socket) {
+                            enet_socket_destroy(socket);
+                        }
+                        continue;
+                    }
+                    enet_socket_set_option(socket, ENET_SOCKOPT_NONBLOCK, 1);
+
+                    // seeded by the order flows show up in, so one scripted client always gets the same luck
+                    f = &flows[flowCount++];
+                    f->client = from;
+                    f->socket = socket;
+                    Impair_Init(&f->up, settings, seed * 0x9E3779B97F4A7C15ull + 2 * flowsCreated);
+                    Impair_Init(&f->down, settings, seed * 0x9E3779B97F4A7C15ull + 2 * flowsCreated + 1);
+                    flowsCreated++;
+                    if (profileStart < 0.0) {
+                        profileStart = now;
+                    }
+                    Log_Write(LOGLEVEL_INFO, "flow_open", "host=%x port=%u flows=%d", from.host, from.port, flowCount);
+                }
+
+                f->lastActive = now;
+                if (Impair_Push(&f->up, datagram, len, now) != 0) {
+                    Log_Write(LOGLEVEL_WARN, "queue_alloc_failed", "dir=up len=%d", len);
+                }
+            }
+        }
+
+        for (i32 i = 0; i < flowCount; i++) {
+            if (!ENET_SOCKETSET_CHECK(readSet, flows[i].socket)) {
+                continue;
+            }
+            for (;;) {
+                ENetAddress from;
+                ENetBuffer buffer = { .data = datagram, .dataLength = sizeof(datagram) };
+                const i32 len = enet_socket_receive(flows[i].socket, &from, &buffer, 1);
+                if (len <= 0) {
+                    break;
+                }
+                if (from.host != server.host || from.port != server.port) {
+                    continue;
+                }
+                if (Impair_Push(&flows[i].down, datagram, len, now) != 0) {
+                    Log_Write(LOGLEVEL_WARN, "queue_alloc_failed", "dir=down len=%d", len);
+                }
+            }
+        }
+
+        // enet gives up on a silent peer well before this, so nothing is cut off mid game
+        for (i32 i = flowCount - 1; i >= 0; i--) {
+            if (now - flows[i].lastActive > FLOW_TIMEOUT) {
+                Log_Write(LOGLEVEL_INFO, "flow_close", "host=%x port=%u", flows[i].client.host, flows[i].client.port);
+                AddStats(&closedUp, &flows[i].up.stats);
+                AddStats(&closedDown, &flows[i].down.stats);
+                FreeFlow(&flows[i]);
+                flows[i] = flows[--flowCount];
+            }
+        }
+
+        if (now >= nextReport) {
+            ImpairStats up = closedUp, down = closedDown;
+            i32 upQueued = 0, downQueued = 0;
+            for (i32 i = 0; i < flowCount; i++) {
+                AddStats(&up, &flows[i].up.stats);
+                AddStats(&down, &flows[i].down.stats);
+                upQueued += flows[i].up.count;
+                downQueued += flows[i].down.count;
+            }
+            LogDirection("up", &up, upQueued);
+            LogDirection("down", &down, downQueued);
+            nextReport += reportInterval;
+        }
+    }
+
+    for (i32 i = 0; i < flowCount; i++) {
+        FreeFlow(&flows[i]);
+    }
+    enet_socket_destroy(listenSocket);
+    enet_deinitialize();
+    Impair_FreeProfile(&profile);
+    return 0;
+}
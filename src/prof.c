@@ -0,0 +1,155 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../inc/prof.h"
+#include "../inc/log.h"
+#include "../inc/tick.h"
+
+#define SMOOTHING 0.05 // weight of each new frame in the averages
+
+typedef struct profEvent {
+    f64 start; // seconds, Tick_Now
+    f32 duration;
+    u8 zone;
+    u8 thread;
+} ProfEvent;
+
+static const i8* zoneNames[PROF_ZONE_COUNT] = {
+    [PROF_COLLIDE] = "collide",
+    [PROF_WORLD_STEP] = "world_step",
+    [PROF_EXTRACT] = "extract",
+    [PROF_BROADCAST] = "broadcast",
+    [PROF_SNAPSHOT_DECODE] = "snapshot_decode",
+    [PROF_SHADOW_PASS] = "shadow_pass",
+    [PROF_DRAW_SCENE] = "draw_scene"
+};
+
+static _Thread_local f64 zoneStart[PROF_ZONE_COUNT];
+static _Thread_local i32 threadID = 0; // 0 until the thread's first zone
+static atomic_int threadCount = 0;
+
+// summed per thread, only the thread calling Prof_FrameEnd rolls its own into the averages
+static _Thread_local f64 frameTotal[PROF_ZONE_COUNT];
+static _Thread_local u32 frameCalls[PROF_ZONE_COUNT];
+static f64 average[PROF_ZONE_COUNT];
+static u32 lastCalls[PROF_ZONE_COUNT];
+
+static ProfEvent* events = NULL;
+static atomic_int capturing = 0;
+static atomic_uint eventCount = 0;
+static atomic_int writers = 0; // zones between deciding to record and finishing their event
+static f64 captureStart;
+
+void Prof_Begin(ProfZone zone) {
+    zoneStart[zone] = Tick_Now();
+}
+
+void Prof_End(ProfZone zone) {
+    const f64 start = zoneStart[zone];
+    const f64 duration = Tick_Now() - start;
+    frameTotal[zone] += duration;
+    frameCalls[zone]++;
+
+    if (!atomic_load_explicit(&capturing, memory_order_relaxed)) {
+        return;
+    }
+    // checked again once counted as a writer, so a capture that stops in between
+    // either waits for this event or this never starts writing one
+    atomic_fetch_add(&writers, 1);
+    if (!atomic_load(&capturing)) {
+        atomic_fetch_sub_explicit(&writers, 1, memory_order_release);
+        return;
+    }
+    const u32 i = atomic_fetch_add_explicit(&eventCount, 1, memory_order_relaxed);
+    if (i < PROF_MAX_EVENTS) {
+        if (0 == threadID) {
+            threadID = atomic_fetch_add(&threadCount, 1) + 1;
+        }
+        events[i] = (ProfEvent){ .start = start, .duration = duration, .zone = zone, .thread = threadID };
+    }
+    atomic_fetch_sub_explicit(&writers, 1, memory_order_release);
+}
+
+void Prof_FrameEnd(void) {
+    for (i32 i = 0; i < PROF_ZONE_COUNT; i++) {
+        average[i] += (frameTotal[i] * 1000.0 - average[i]) * SMOOTHING;
+        lastCalls[i] = frameCalls[i];
+        frameTotal[i] = 0.0;
+        frameCalls[i] = 0;
+    }
+}
+
+const i8* Prof_ZoneName(ProfZone zone) {
+    return zoneNames[zone];
+}
+
+f64 Prof_Average(ProfZone zone) {
+    return average[zone];
+}
+
+u32 Prof_Calls(ProfZone zone) {
+    return lastCalls[zone];
+}
+
+i8 Prof_Capturing(void) {
+    return atomic_load(&capturing);
+}
+
+// events only take a few stores, so this never spins for long
+static void WaitForWriters(void) {
+    while (0 != atomic_load_explicit(&writers, memory_order_acquire)) {
+    }
+}
+
+static i8 WriteTrace(const i8* path, u32 count) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        return 1;
+    }
+
+    // complete events, timestamps in microseconds from the start of the capture
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    for (u32 i = 0; i < count; i++) {
+        const ProfEvent* e = &events[i];
+        fprintf(f, "{\"name\":\"%s\",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+            zoneNames[e->zone], e->thread, (e->start - captureStart) * 1e6, e->duration * 1e6, i + 1 < count ? "," : "");
+    }
+    fputs("]}\n", f);
+    return fclose(f) != 0;
+}
+
+i8 Prof_ToggleCapture(void) {
+    if (!atomic_load(&capturing)) {
+        if (!events) {
+            events = malloc(sizeof(ProfEvent) * PROF_MAX_EVENTS);
+            if (!events) {
+                Log_Write(LOGLEVEL_ERROR, "trace_alloc_failed", "events=%d", PROF_MAX_EVENTS);
+                return 1;
+            }
+        }
+        WaitForWriters();
+        atomic_store(&eventCount, 0);
+        captureStart = Tick_Now();
+        atomic_store(&capturing, 1);
+        Log_Write(LOGLEVEL_INFO, "trace_start", "max_events=%d", PROF_MAX_EVENTS);
+        return 0;
+    }
+
+    // zones on other threads may still be finishing their events
+    atomic_store(&capturing, 0);
+    WaitForWriters();
+
+    const u32 recorded = atomic_load(&eventCount);
+    const u32 count = recorded < PROF_MAX_EVENTS ? recorded : PROF_MAX_EVENTS;
+    i8 path[64];
+    const time_t now = time(NULL);
+    strftime(path, sizeof(path), "trace_%Y%m%d_%H%M%S.json", localtime(&now));
+    if (WriteTrace(path, count) != 0) {
+        Log_Write(LOGLEVEL_ERROR, "trace_write_failed", "path=%s", path);
+        return 1;
+    }
+    Log_Write(LOGLEVEL_INFO, "trace_written", "path=%s events=%u dropped=%u seconds=%.2f", path, count, recorded - count, Tick_Now() - captureStart);
+    return 0;
+}
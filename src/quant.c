@@ -0,0 +1,134 @@
+#include <math.h>
+
+#include "../inc/quant.h"
+
+#define POS_MAX ((1u << QUANT_POS_BITS) - 1)
+#define ROT_MAX ((1u << QUANT_ROT_BITS) - 1)
+#define ANGLE_MAX ((1u << QUANT_ANGLE_BITS) - 1)
+#define ROT_RANGE 0.70710678f // the three smallest components of a unit quaternion are within +-1/sqrt(2)
+
+// transform is column major, this is row r column c of its rotation
+#define M(t, r, c) ((t)[(c) * 4 + (r)])
+
+static u32 PackUnit(f32 v, f32 min, f32 max, u32 maxValue) {
+    const f32 t = (v - min) / (max - min);
+    if (t <= 0.f) {
+        return 0;
+    }
+    if (t >= 1.f) {
+        return maxValue;
+    }
+    return (u32)(t * maxValue + 0.5f);
+}
+
+static f32 UnpackUnit(u32 v, f32 min, f32 max, u32 maxValue) {
+    return min + (max - min) * ((f32)v / maxValue);
+}
+
+void Quant_PackPos(u16 res[3], const dReal trans[16], const QuantBounds* bounds) {
+    res[0] = PackUnit(trans[12], bounds->min.x, bounds->max.x, POS_MAX);
+    res[1] = PackUnit(trans[13], bounds->min.y, bounds->max.y, POS_MAX);
+    res[2] = PackUnit(trans[14], bounds->min.z, bounds->max.z, POS_MAX);
+}
+
+void Quant_UnpackPos(dReal trans[16], const u16 pos[3], const QuantBounds* bounds) {
+    trans[12] = UnpackUnit(pos[0], bounds->min.x, bounds->max.x, POS_MAX);
+    trans[13] = UnpackUnit(pos[1], bounds->min.y, bounds->max.y, POS_MAX);
+    trans[14] = UnpackUnit(pos[2], bounds->min.z, bounds->max.z, POS_MAX);
+}
+
+u32 Quant_PackRot(const dReal trans[16]) {
+    f32 q[4]; // x y z w
+    const f32 tr = M(trans, 0, 0) + M(trans, 1, 1) + M(trans, 2, 2);
+    if (tr > 0.f) {
+        const f32 s = 0.5f / sqrtf(tr + 1.f);
+        q[3] = 0.25f / s;
+        q[0] = (M(trans, 2, 1) - M(trans, 1, 2)) * s;
+        q[1] = (M(trans, 0, 2) - M(trans, 2, 0)) * s;
+        q[2] = (M(trans, 1, 0) - M(trans, 0, 1)) * s;
+    } else if (M(trans, 0, 0) > M(trans, 1, 1) && M(trans, 0, 0) > M(trans, 2, 2)) {
+        const f32 s = 2.f * sqrtf(1.f + M(trans, 0, 0) - M(trans, 1, 1) - M(trans, 2, 2));
+        q[3] = (M(trans, 2, 1) - M(trans, 1, 2)) / s;
+        q[0] = 0.25f * s;
+        q[1] = (M(trans, 0, 1) + M(trans, 1, 0)) / s;
+        q[2] = (M(trans, 0, 2) + M(trans, 2, 0)) / s;
+    } else if (M(trans, 1, 1) > M(trans, 2, 2)) {
+        const f32 s = 2.f * sqrtf(1.f + M(trans, 1, 1) - M(trans, 0, 0) - M(trans, 2, 2));
+        q[3] = (M(trans, 0, 2) - M(trans, 2, 0)) / s;
+        q[0] = (M(trans, 0, 1) + M(trans, 1, 0)) / s;
+        q[1] = 0.25f * s;
+        q[2] = (M(trans, 1, 2) + M(trans, 2, 1)) / s;
+    } else {
+        const f32 s = 2.f * sqrtf(1.f + M(trans, 2, 2) - M(trans, 0, 0) - M(trans, 1, 1));
+        q[3] = (M(trans, 1, 0) - M(trans, 0, 1)) / s;
+        q[0] = (M(trans, 0, 2) + M(trans, 2, 0)) / s;
+        q[1] = (M(trans, 1, 2) + M(trans, 2, 1)) / s;
+        q[2] = 0.25f * s;
+    }
+
+    u32 largest = 0;
+    for (u32 i = 1; i < 4; i++) {
+        if (fabsf(q[i]) > fabsf(q[largest])) {
+            largest = i;
+        }
+    }
+
+    // q and -q are the same rotation, flip so the dropped one is positive
+    const f32 sign = q[largest] < 0.f ? -1.f : 1.f;
+
+    u32 res = largest;
+    for (u32 i = 0; i < 4; i++) {
+        if (i != largest) {
+            res = (res << QUANT_ROT_BITS) | PackUnit(q[i] * sign, -ROT_RANGE, ROT_RANGE, ROT_MAX);
+        }
+    }
+    return res;
+}
+
+void Quant_UnpackRot(dReal trans[16], u32 rot) {
+    const u32 largest = rot >> (3 * QUANT_ROT_BITS);
+
+    f32 q[4];
+    f32 sum = 0.f;
+    for (i32 i = 3; i >= 0; i--) {
+        if ((u32)i == largest) {
+            continue;
+        }
+        q[i] = UnpackUnit(rot & ROT_MAX, -ROT_RANGE, ROT_RANGE, ROT_MAX);
+        sum += q[i] * q[i];
+        rot >>= QUANT_ROT_BITS;
+    }
+    q[largest] = sqrtf(fmaxf(0.f, 1.f - sum));
+
+    const f32 x = q[0], y = q[1], z = q[2], w = q[3];
+    M(trans, 0, 0) = 1.f - 2.f * (y * y + z * z);
+    M(trans, 0, 1) = 2.f * (x * y - z * w);
+    M(trans, 0, 2) = 2.f * (x * z + y * w);
+    M(trans, 1, 0) = 2.f * (x * y + z * w);
+    M(trans, 1, 1) = 1.f - 2.f * (x * x + z * z);
+    M(trans, 1, 2) = 2.f * (y * z - x * w);
+    M(trans, 2, 0) = 2.f * (x * z - y * w);
+    M(trans, 2, 1) = 2.f * (y * z + x * w);
+    M(trans, 2, 2) = 1.f - 2.f * (x * x + y * y);
+
+    trans[3] = trans[7] = trans[11] = 0.0;
+    trans[15] = 1.0;
+}
+
+u16 Quant_PackYaw(f32 yaw) {
+    const f32 turns = yaw / (2.f * PI);
+    // rounding up to a full turn wraps back to 0 through the mask
+    return (u32)((turns - floorf(turns)) * (ANGLE_MAX + 1) + 0.5f) & ANGLE_MAX;
+}
+
+f32 Quant_UnpackYaw(u16 yaw) {
+    return yaw * (2.f * PI / (ANGLE_MAX + 1));
+}
+
+u16 Quant_PackPitch(f32 pitch, f32 maxPitch) {
+    return PackUnit(pitch, -maxPitch, maxPitch, ANGLE_MAX);
+}
+
+f32 Quant_UnpackPitch(u16 pitch, f32 maxPitch) {
+    return UnpackUnit(pitch, -maxPitch, maxPitch, ANGLE_MAX);
+}
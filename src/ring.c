@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/ring.h"
+
+i8 Ring_Init(Ring* r, u32 itemSize, u32 capacity) {
+    u32 size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    r->items = malloc((size_t)itemSize * size);
+    if (!r->items) {
+        return 1;
+    }
+
+    r->itemSize = itemSize;
+    r->mask = size - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->overflows, 0);
+    atomic_init(&r->peakDepth, 0);
+    return 0;
+}
+
+void Ring_Free(Ring* r) {
+    free(r->items);
+    r->items = NULL;
+}
+
+i8 Ring_Push(Ring* r, const void* item) {
+    const u32 head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    const u32 tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    const u32 depth = head - tail;
+    if (depth > r->mask) {
+        atomic_fetch_add_explicit(&r->overflows, 1, memory_order_relaxed);
+        return 0;
+    }
+
+    memcpy(r->items + (size_t)(head & r->mask) * r->itemSize, item, r->itemSize);
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+
+    if (depth + 1 > atomic_load_explicit(&r->peakDepth, memory_order_relaxed)) {
+        atomic_store_explicit(&r->peakDepth, depth + 1, memory_order_relaxed);
+    }
+    return 1;
+}
+
+i8 Ring_Pop(Ring* r, void* item) {
+    const u32 tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    const u32 head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) {
+        return 0;
+    }
+
+    memcpy(item, r->items + (size_t)(tail & r->mask) * r->itemSize, r->itemSize);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+u32 Ring_Depth(Ring* r) {
+    const u32 tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    const u32 head = atomic_load_explicit(&r->head, memory_order_acquire);
+    return head - tail;
+}
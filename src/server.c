@@ -1,18 +1,25 @@
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <enet/enet.h>
 
 #include "../inc/util.h"
 #include "../inc/msgs.h"
+#include "../inc/snapshot.h"
 #include "../inc/player.h"
+#include "../inc/move.h"
 
-typedef struct peerInfo {
-    ENetPeer* peer;
-    i32 playerID;
-} PeerInfo;
+#define UPDATE_TIME_MS 16    // players that changed are sent together at most this often
+#define REFRESH_TIME_MS 1000 // and all of them this often, so a lost update doesn't leave anyone stale
 
-static PeerInfo peerInfo[MAX_PLAYERS];
+// a connected peer's data is its slot + 1, unused slots are a stack
+static i32 freeSlots[DEFAULT_MAX_PLAYERS];
+static i32 freeCount = 0;
+
+static i32 updateSlots[DEFAULT_MAX_PLAYERS];
+static PlayerState updatePlayers[DEFAULT_MAX_PLAYERS];
 
 i32 main() {
     if (enet_initialize() != 0) {
@@ -21,57 +28,85 @@ i32 main() {
     }
 
     ENetAddress address = { .host = ENET_HOST_ANY, .port = 12345 };
-    ENetHost* server = enet_host_create(&address, MAX_PLAYERS, 2, 0, 0);
+    ENetHost* server = enet_host_create(&address, DEFAULT_MAX_PLAYERS, CHANNEL_COUNT, 0, 0);
     if (server == NULL) {
         fprintf(stderr, "An error occurred while trying to create the server.\n");
         return EXIT_FAILURE;
     }
 
-    for (i32 i = 0; i < MAX_PLAYERS; i++) {
-        peerInfo[i].peer = NULL;
-        players[i].id = peerInfo[i].playerID = -1;
-        players[i].pos.x = players[i].pos.y = players[i].dir.x = players[i].dir.y = 0.f;
+    playerCapacity = DEFAULT_MAX_PLAYERS;
+    players = malloc(sizeof(PlayerState) * playerCapacity);
+    const size_t updateBufSize = Msg_UpdatePlayersMaxSize(playerCapacity);
+    u8* updateBuf = malloc(updateBufSize);
+    if (!players || !updateBuf) {
+        fprintf(stderr, "An error occurred while allocating the players.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (i32 i = 0; i < playerCapacity; i++) {
+        players[i].id = -1;
+        Move_Spawn(&players[i]);
+        freeSlots[freeCount++] = playerCapacity - 1 - i;
     }
 
     printf("Server started on port %d\n", address.port);
 
+    u32 dirty[PLAYER_MASK_WORDS(DEFAULT_MAX_PLAYERS)] = {0};
+    enet_uint32 nextUpdate = enet_time_get();
+    enet_uint32 nextRefresh = nextUpdate;
+
     ENetEvent event;
     while (1) {
-        while (enet_host_service(server, &event, 1000) > 0) {
-            u8 playerUpdated = 0;
+        // sleeps until the next update is due unless something arrives first
+        const enet_uint32 now = enet_time_get();
+        enet_uint32 timeout = ENET_TIME_LESS(now, nextUpdate) ? ENET_TIME_DIFFERENCE(nextUpdate, now) : 0;
+        while (enet_host_service(server, &event, timeout) > 0) {
+            timeout = 0;
             switch (event.type) {
                 case ENET_EVENT_TYPE_CONNECT: {
                     printf("A new client connected.\n");
-                    u8 foundEmpty = 0;
-                    for (i32 i = 0; i < MAX_PLAYERS; i++) {
-                        if (players[i].id != -1) {
-                            continue;
-                        }
-
-                        players[i].id = i;
-                        players[i].pos = players[i].dir = (Vector3){0.f, 0.f, 0.f};
-                        peerInfo[i].playerID = i;
-                        peerInfo[i].peer = event.peer;
-
-                        MsgPlayerID idMsg = { .msg = MSGTYPE_C_PLAYER_ID, .playerID = i };
-                        ENetPacket* packet = enet_packet_create(&idMsg, sizeof(MsgPlayerID), ENET_PACKET_FLAG_RELIABLE);
-                        enet_peer_send(event.peer, 0, packet);
-                        playerUpdated = 1;
-
-                        printf("Assigned player ID: %d\n", i);
-                        foundEmpty = 1;
+                    if (PROTOCOL_VERSION != event.data) {
+                        enet_peer_disconnect(event.peer, DISCONNECT_VERSION);
                         break;
                     }
-                    if (!foundEmpty) {
-                        enet_peer_disconnect(event.peer, 0);
+                    if (0 == freeCount) {
+                        enet_peer_disconnect(event.peer, DISCONNECT_FULL);
+                        break;
                     }
+
+                    const i32 i = freeSlots[--freeCount];
+                    Move_Spawn(&players[i]);
+                    players[i].id = i;
+                    event.peer->data = (void*)(intptr_t)(i + 1);
+
+                    u8 buf[MSG_MAX_SIZE];
+                    const size_t len = Msg_WritePlayerID(buf, sizeof(buf), &(MsgPlayerID){ .playerID = i, .maxPlayers = playerCapacity, .bounds = QUANT_DEFAULT_BOUNDS, .tickTime = 1.f / 60.f, .snapshotHistory = SNAPSHOT_MIN_HISTORY });
+                    enet_peer_send(event.peer, CHANNEL_RELIABLE, enet_packet_create(buf, len, ENET_PACKET_FLAG_RELIABLE));
+                    // the new client needs everyone, not just what changed
+                    PLAYER_MASK_SET(dirty, i);
+                    nextRefresh = enet_time_get();
+
+                    printf("Assigned player ID: %d\n", i);
                 } break;
                 case ENET_EVENT_TYPE_RECEIVE: {
-                    switch (*(MsgType*)event.packet->data) {
-                        case MSGTYPE_S_PLAYER_UPDATE: {
-                            MsgPlayerUpdate* player = (MsgPlayerUpdate*)event.packet->data;
-                            players[player->player.id] = player->player;
-                            playerUpdated = 1;
+                    switch (Msg_Type(event.packet->data, event.packet->dataLength)) {
+                        case MSGTYPE_S_PLAYER_INPUT: {
+                            MsgPlayerInput msg;
+                            if (Msg_ReadPlayerInput(event.packet->data, event.packet->dataLength, &msg) != 0) {
+                                break;
+                            }
+                            // the message doesn't carry an id, the slot is whichever one this peer has
+                            const i32 i = (i32)(intptr_t)event.peer->data - 1;
+                            if (-1 == i) {
+                                break;
+                            }
+                            for (i32 j = 0; j < msg.count; j++) {
+                                if (msg.inputs[j].seq > players[i].lastInput) {
+                                    Move_Simulate(&players[i], &msg.inputs[j]);
+                                    players[i].lastInput = msg.inputs[j].seq;
+                                    PLAYER_MASK_SET(dirty, i);
+                                }
+                            }
                         } break;
                         default: {
                             TraceLog(LOG_WARNING, TextFormat("Received unknown message of length %d", event.packet->dataLength));
@@ -80,28 +115,42 @@ i32 main() {
                     enet_packet_destroy(event.packet);
                 } break;
                 case ENET_EVENT_TYPE_DISCONNECT: {
-                    for (i32 i = 0; i < MAX_PLAYERS; i++) {
-                        if (event.peer != peerInfo[i].peer) {
-                            continue;
-                        }
-
-                        players[i].id = -1;
-                        peerInfo[i].playerID = -1;
-                        peerInfo[i].peer = NULL;
-                        playerUpdated = 1;
-                        printf("A client disconnected (ID: %d)\n", i);
+                    const i32 i = (i32)(intptr_t)event.peer->data - 1;
+                    if (-1 == i) {
                         break;
                     }
+
+                    players[i].id = -1;
+                    event.peer->data = NULL;
+                    freeSlots[freeCount++] = i;
+                    PLAYER_MASK_SET(dirty, i);
+                    printf("A client disconnected (ID: %d)\n", i);
                 } break;
                 default: break;
             }
+        }
 
-            if (playerUpdated) {
-                MsgUpdatePlayers updatedPlayers = { .msg = MSGTYPE_C_UPDATE_PLAYERS };
-                memcpy(updatedPlayers.players, players, sizeof(players));
-                ENetPacket* packet = enet_packet_create(&updatedPlayers, sizeof(MsgUpdatePlayers), ENET_PACKET_FLAG_RELIABLE);
-                enet_host_broadcast(server, 0, packet);
-            }
+        const enet_uint32 time = enet_time_get();
+        if (ENET_TIME_LESS(time, nextUpdate)) {
+            continue;
+        }
+        nextUpdate = time + UPDATE_TIME_MS;
+
+        // everything that changed since the last one goes out together
+        const u8 full = !ENET_TIME_LESS(time, nextRefresh);
+        u8 anyDirty = 0;
+        for (i32 i = 0; i < PLAYER_MASK_WORDS(DEFAULT_MAX_PLAYERS); i++) {
+            anyDirty |= 0 != dirty[i];
+        }
+        if (full || anyDirty) {
+            MsgUpdatePlayers updatedPlayers = { .capacity = playerCapacity, .slots = updateSlots, .players = updatePlayers };
+            Msg_CollectPlayers(&updatedPlayers, players, dirty, full);
+            const size_t len = Msg_WriteUpdatePlayers(updateBuf, updateBufSize, &updatedPlayers);
+            enet_host_broadcast(server, CHANNEL_STATE, enet_packet_create(updateBuf, len, ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT));
+            memset(dirty, 0, sizeof(dirty));
+        }
+        if (full) {
+            nextRefresh = time + REFRESH_TIME_MS;
         }
     }
 
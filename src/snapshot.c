@@ -0,0 +1,492 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../inc/snapshot.h"
+#include "../inc/msgs.h"
+
+#include "../inc/bits.h"
+
+#define HEADER_BITS (MSGTYPE_BITS + 32 + 32 + 32 + 16)
+#define SPAWN_BITS (1 + 3 * 32 + 32)
+#define MAX_ID_BITS 16
+#define MAX_ENTRY_BITS (MAX_ID_BITS + SNAPFIELD_BITS + SPAWN_BITS + 3 * QUANT_POS_BITS + 32)
+#define LEVEL_ENTRY_BITS (MAX_ID_BITS + SPAWN_BITS + 12 * 32)
+
+static const i32 rotIndices[9] = { 0, 1, 2, 4, 5, 6, 8, 9, 10 };
+
+static void WriteSpawn(BitWriter* w, const BodyState* state) {
+    Bits_WriteRange(w, state->type, BODYTYPE_SPHERE, BODYTYPE_BOX);
+    Bits_WriteF32(w, state->size.x);
+    Bits_WriteF32(w, state->size.y);
+    Bits_WriteF32(w, state->size.z);
+    const Color col = state->col;
+    Bits_Write(w, col.r | col.g << 8 | col.b << 16 | (u32)col.a << 24, 32);
+}
+
+// returns 0 if the body can't be rendered
+static i8 ReadSpawn(BitReader* r, BodyState* state) {
+    state->type = Bits_ReadRange(r, BODYTYPE_SPHERE, BODYTYPE_BOX);
+    state->size.x = Bits_ReadF32(r);
+    state->size.y = Bits_ReadF32(r);
+    state->size.z = Bits_ReadF32(r);
+    const u32 col = Bits_Read(r, 32);
+    state->col = (Color){ col & 0xff, col >> 8 & 0xff, col >> 16 & 0xff, col >> 24 };
+    return !r->failed && Body_ValidSize(state->type, state->size, INFINITY);
+}
+
+i8 Snapshot_SourceInit(SnapSource* src, i32 capacity, QuantBounds bounds) {
+    src->bodies = calloc(capacity, sizeof(NetBody));
+    src->states = NULL;
+    src->tick = 0;
+    src->capacity = capacity;
+    src->bounds = bounds;
+    return src->bodies ? 0 : 1;
+}
+
+void Snapshot_SourceFree(SnapSource* src) {
+    free(src->bodies);
+    src->bodies = NULL;
+}
+
+void Snapshot_SourceUpdate(SnapSource* src, const BodyState* states, const i32* ids, i32 count, u32 tick) {
+    src->states = states;
+    src->tick = tick;
+
+    for (i32 n = 0; n < count; n++) {
+        const i32 i = ids[n];
+        NetBody* body = &src->bodies[i];
+        const u8 present = BODYTYPE_NULL != states[i].type;
+        if (body->present && present && body->asleep && !states[i].isAwake) {
+            continue;
+        }
+
+        body->present = present;
+        body->asleep = present && !states[i].isAwake;
+        Quant_PackPos(body->pos, states[i].transform, &src->bounds);
+        body->rot = Quant_PackRot(states[i].transform);
+    }
+}
+
+i32 Snapshot_HistoryFor(f64 maxRtt, f64 broadcastRate) {
+    // one more for the slot the next snapshot overwrites and one for an ack that lands just after it
+    const f64 history = ceil(maxRtt * broadcastRate) + 2.0;
+    if (history < SNAPSHOT_MIN_HISTORY) {
+        return SNAPSHOT_MIN_HISTORY;
+    }
+    return history > SNAPSHOT_MAX_HISTORY ? SNAPSHOT_MAX_HISTORY : (i32)history;
+}
+
+i8 Snapshot_ClientInit(SnapClient* c, i32 capacity, i32 history, size_t budget) {
+    c->capacity = capacity;
+    c->history = history;
+    c->budget = budget * 8 < HEADER_BITS + MAX_ENTRY_BITS ? (HEADER_BITS + MAX_ENTRY_BITS + 7) / 8 : budget;
+    c->nextSeq = 1;
+    c->ackedSeq = 0;
+    c->deferred = 0;
+    c->priority = calloc(capacity, sizeof(f32));
+    c->pending = malloc(sizeof(SnapPending) * capacity);
+    c->order = malloc(sizeof(SnapRank) * capacity);
+    c->frames = calloc(history, sizeof(SnapFrame));
+    if (!c->frames) {
+        Snapshot_ClientFree(c);
+        return 1;
+    }
+    for (i32 i = 0; i < history; i++) {
+        c->frames[i].seq = 0;
+        c->frames[i].count = 0;
+        c->frames[i].ids = malloc(sizeof(u16) * capacity);
+        c->frames[i].bodies = malloc(sizeof(NetBody) * capacity);
+    }
+
+    for (i32 i = 0; i < history; i++) {
+        if (!c->frames[i].ids || !c->frames[i].bodies) {
+            Snapshot_ClientFree(c);
+            return 1;
+        }
+    }
+    if (!c->priority || !c->pending || !c->order) {
+        Snapshot_ClientFree(c);
+        return 1;
+    }
+    return 0;
+}
+
+void Snapshot_ClientFree(SnapClient* c) {
+    for (i32 i = 0; c->frames && i < c->history; i++) {
+        free(c->frames[i].ids);
+        free(c->frames[i].bodies);
+    }
+    free(c->frames);
+    c->frames = NULL;
+    free(c->priority);
+    free(c->pending);
+    free(c->order);
+    c->priority = NULL;
+    c->pending = NULL;
+    c->order = NULL;
+}
+
+void Snapshot_ClientAck(SnapClient* c, u32 seq) {
+    // acks can arrive out of order, and never for something we didn't send
+    if (seq > c->ackedSeq && seq < c->nextSeq) {
+        c->ackedSeq = seq;
+    }
+}
+
+size_t Snapshot_MaxSize(i32 capacity) {
+    return (HEADER_BITS + (size_t)capacity * (MAX_ENTRY_BITS > LEVEL_ENTRY_BITS ? MAX_ENTRY_BITS : LEVEL_ENTRY_BITS) + 7) / 8;
+}
+
+static size_t EntryBits(u8 fields, i32 idBits) {
+    size_t bits = idBits + SNAPFIELD_BITS;
+    if (fields & SNAPFIELD_SPAWN) bits += SPAWN_BITS;
+    if (fields & SNAPFIELD_POS) bits += 3 * QUANT_POS_BITS;
+    if (fields & SNAPFIELD_ROT) bits += 32;
+    return bits;
+}
+
+// how much sending this body now would help, added to its accumulator every
+// snapshot it's left out of so anything starved eventually wins
+static f32 PriorityWeight(const SnapSource* src, const SnapPending* p, Vector3 viewPos) {
+    const dReal* trans = src->states[p->id].transform;
+    const f32 dx = trans[12] - viewPos.x;
+    const f32 dy = trans[13] - viewPos.y;
+    const f32 dz = trans[14] - viewPos.z;
+    const f32 dist = sqrtf(dx * dx + dy * dy + dz * dz);
+
+    // spawns and removes are what the player notices most, the rest scales with
+    // how far the client's copy has drifted, which is speed times time since the last send
+    f32 error = 4.f;
+    if (!(p->fields & (SNAPFIELD_SPAWN | SNAPFIELD_REMOVE))) {
+        const QuantBounds* bn = &src->bounds;
+        const f32 scale[3] = { bn->max.x - bn->min.x, bn->max.y - bn->min.y, bn->max.z - bn->min.z };
+        error = p->fields & SNAPFIELD_ROT ? 0.25f : 0.f;
+        for (i32 j = 0; j < 3; j++) {
+            error += fabsf((f32)p->cur->pos[j] - (f32)p->sent->pos[j]) * scale[j] / ((1 << QUANT_POS_BITS) - 1);
+        }
+    }
+
+    return (1.f + error) / (1.f + dist * 0.1f);
+}
+
+static i32 ComparePriority(const void* a, const void* b) {
+    const f32 pa = ((const SnapRank*)a)->priority;
+    const f32 pb = ((const SnapRank*)b)->priority;
+    return (pa < pb) - (pa > pb);
+}
+
+size_t Snapshot_Encode(SnapClient* c, const SnapSource* src, const i32* visible, i32 visibleCount, Vector3 viewPos, u8* buf, size_t bufSize) {
+    if (bufSize < Snapshot_MaxSize(c->capacity)) {
+        return 0;
+    }
+
+    const u32 seq = c->nextSeq++;
+    SnapFrame* frame = &c->frames[seq % c->history];
+
+    // the baseline is only usable while it's still in the history
+    // and isn't the slot this snapshot is about to overwrite
+    const SnapFrame* baseline = NULL;
+    if (c->ackedSeq != 0 && seq - c->ackedSeq < (u32)c->history && c->frames[c->ackedSeq % c->history].seq == c->ackedSeq) {
+        baseline = &c->frames[c->ackedSeq % c->history];
+    }
+    const u32 baselineSeq = baseline ? baseline->seq : 0;
+
+    // both lists are sorted so one merge pass finds the updates, enters and leaves
+    const i32 baseCount = baseline ? baseline->count : 0;
+    i32 v = 0, b = 0, pendingCount = 0, changed = 0;
+    while (v < visibleCount || b < baseCount) {
+        const i32 vid = v < visibleCount ? visible[v] : c->capacity;
+        const i32 bid = b < baseCount ? baseline->ids[b] : c->capacity;
+        SnapPending* p = &c->pending[pendingCount++];
+        p->id = vid < bid ? vid : bid;
+        p->cur = p->id == vid && src->bodies[vid].present ? &src->bodies[vid] : NULL;
+        p->sent = p->id == bid ? &baseline->bodies[b] : NULL;
+        p->send = 0;
+        v += p->id == vid;
+        b += p->id == bid;
+
+        p->fields = 0;
+        if (!p->cur) {
+            if (p->sent) {
+                p->fields = SNAPFIELD_REMOVE;
+            }
+        } else if (!p->sent) {
+            p->fields = SNAPFIELD_SPAWN | SNAPFIELD_POS | SNAPFIELD_ROT;
+        } else {
+            if (0 != memcmp(p->cur->pos, p->sent->pos, sizeof(p->cur->pos))) {
+                p->fields |= SNAPFIELD_POS;
+            }
+            if (p->cur->rot != p->sent->rot) {
+                p->fields |= SNAPFIELD_ROT;
+            }
+            // waking up resends the position so the client hears about it
+            if (p->sent->asleep && !p->cur->asleep) {
+                p->fields |= SNAPFIELD_POS;
+            }
+            if (p->cur->asleep && !p->sent->asleep) {
+                p->fields |= SNAPFIELD_SLEEP;
+            }
+        }
+        if (p->cur && p->cur->asleep && 0 != p->fields) {
+            p->fields |= SNAPFIELD_SLEEP;
+        }
+
+        if (0 == p->fields) {
+            c->priority[p->id] = 0.f;
+            continue;
+        }
+        c->priority[p->id] += PriorityWeight(src, p, viewPos);
+        c->order[changed++] = (SnapRank){ .priority = c->priority[p->id], .pending = pendingCount - 1 };
+    }
+
+    // most important first, skipping anything that doesn't fit so smaller ones can still fill the gap
+    qsort(c->order, changed, sizeof(SnapRank), ComparePriority);
+    const i32 idBits = Bits_Range(0, c->capacity - 1);
+    size_t bits = HEADER_BITS;
+    c->deferred = 0;
+    for (i32 n = 0; n < changed; n++) {
+        SnapPending* p = &c->pending[c->order[n].pending];
+        const size_t entryBits = EntryBits(p->fields, idBits);
+        if (bits + entryBits > c->budget * 8) {
+            c->deferred++;
+            continue;
+        }
+        bits += entryBits;
+        p->send = 1;
+        c->priority[p->id] = 0.f;
+    }
+
+    BitWriter w;
+    Bits_WriterInit(&w, buf, bufSize);
+    Bits_Write(&w, MSGTYPE_C_SNAPSHOT, MSGTYPE_BITS);
+    Bits_Write(&w, seq, 32);
+    Bits_Write(&w, baselineSeq, 32);
+    Bits_Write(&w, src->tick, 32);
+    Bits_Write(&w, changed - c->deferred, 16);
+
+    // the frame is what the client has after this. deferred bodies stay as they were in the
+    // baseline, without one the client starts from nothing so they're left out until they spawn
+    frame->seq = seq;
+    frame->count = 0;
+    for (i32 n = 0; n < pendingCount; n++) {
+        const SnapPending* p = &c->pending[n];
+        const NetBody* kept = p->send || 0 == p->fields ? p->cur : p->sent;
+        if (kept) {
+            frame->ids[frame->count] = p->id;
+            frame->bodies[frame->count++] = *kept;
+        }
+
+        if (!p->send) {
+            continue;
+        }
+
+        Bits_Write(&w, p->id, idBits);
+        Bits_Write(&w, p->fields, SNAPFIELD_BITS);
+        if (p->fields & SNAPFIELD_SPAWN) {
+            WriteSpawn(&w, &src->states[p->id]);
+        }
+        if (p->fields & SNAPFIELD_POS) {
+            for (i32 j = 0; j < 3; j++) {
+                Bits_Write(&w, p->cur->pos[j], QUANT_POS_BITS);
+            }
+        }
+        if (p->fields & SNAPFIELD_ROT) {
+            Bits_Write(&w, p->cur->rot, 32);
+        }
+    }
+
+    return w.overflow ? 0 : Bits_WriterBytes(&w);
+}
+
+i8 Snapshot_ReceiverInit(SnapReceiver* r, i32 capacity, i32 history, QuantBounds bounds) {
+    r->capacity = capacity;
+    r->history = history;
+    r->bounds = bounds;
+    r->latestSeq = 0;
+    r->latestTick = 0;
+    r->scratch = calloc(capacity, sizeof(BodyState));
+    r->seqs = calloc(history, sizeof(u32));
+    r->frames = calloc(history, sizeof(BodyState*));
+    if (!r->seqs || !r->frames) {
+        Snapshot_ReceiverFree(r);
+        return 1;
+    }
+    for (i32 i = 0; i < history; i++) {
+        r->frames[i] = calloc(capacity, sizeof(BodyState));
+    }
+
+    for (i32 i = 0; i < history; i++) {
+        if (!r->frames[i]) {
+            Snapshot_ReceiverFree(r);
+            return 1;
+        }
+    }
+    if (!r->scratch) {
+        Snapshot_ReceiverFree(r);
+        return 1;
+    }
+    return 0;
+}
+
+void Snapshot_ReceiverFree(SnapReceiver* r) {
+    for (i32 i = 0; r->frames && i < r->history; i++) {
+        free(r->frames[i]);
+    }
+    free(r->frames);
+    free(r->seqs);
+    r->frames = NULL;
+    r->seqs = NULL;
+    free(r->scratch);
+    r->scratch = NULL;
+}
+
+u32 Snapshot_Decode(SnapReceiver* r, const u8* data, size_t len) {
+    BitReader rd;
+    Bits_ReaderInit(&rd, data, len);
+    const u32 type = Bits_Read(&rd, MSGTYPE_BITS);
+    const u32 seq = Bits_Read(&rd, 32);
+    const u32 baselineSeq = Bits_Read(&rd, 32);
+    const u32 tick = Bits_Read(&rd, 32);
+    const u32 count = Bits_Read(&rd, 16);
+    if (rd.failed || MSGTYPE_C_SNAPSHOT != type || 0 == seq || seq <= r->latestSeq || (baselineSeq != 0 && baselineSeq >= seq)) {
+        return 0;
+    }
+
+    const BodyState* baseline = NULL;
+    if (baselineSeq != 0) {
+        if (r->seqs[baselineSeq % r->history] != baselineSeq || baselineSeq % r->history == seq % r->history) {
+            return 0;
+        }
+        baseline = r->frames[baselineSeq % r->history];
+    }
+
+    // a bad packet can fail halfway through, so nothing in the history is touched until it's all read
+    BodyState* frame = r->scratch;
+    if (baseline) {
+        memcpy(frame, baseline, sizeof(BodyState) * r->capacity);
+    } else {
+        for (i32 i = 0; i < r->capacity; i++) {
+            frame[i].type = BODYTYPE_NULL;
+        }
+    }
+
+    for (u32 n = 0; n < count; n++) {
+        const i32 id = Bits_ReadRange(&rd, 0, r->capacity - 1);
+        const u8 fields = Bits_Read(&rd, SNAPFIELD_BITS);
+        if (rd.failed) {
+            return 0;
+        }
+
+        BodyState* body = &frame[id];
+        if (fields & SNAPFIELD_REMOVE) {
+            body->type = BODYTYPE_NULL;
+            continue;
+        }
+
+        if (fields & SNAPFIELD_SPAWN) {
+            if (!ReadSpawn(&rd, body) || (fields & (SNAPFIELD_POS | SNAPFIELD_ROT)) != (SNAPFIELD_POS | SNAPFIELD_ROT)) {
+                return 0;
+            }
+            body->isStatic = 0;
+        } else if (BODYTYPE_NULL == body->type) {
+            return 0; // an update for a body the client never saw spawn
+        }
+        body->isAwake = !(fields & SNAPFIELD_SLEEP);
+
+        if (fields & SNAPFIELD_POS) {
+            u16 pos[3];
+            for (i32 j = 0; j < 3; j++) {
+                pos[j] = Bits_Read(&rd, QUANT_POS_BITS);
+            }
+            Quant_UnpackPos(body->transform, pos, &r->bounds);
+        }
+        if (fields & SNAPFIELD_ROT) {
+            Quant_UnpackRot(body->transform, Bits_Read(&rd, 32));
+        }
+    }
+
+    if (!Bits_ReaderDone(&rd)) {
+        return 0;
+    }
+
+    r->scratch = r->frames[seq % r->history];
+    r->frames[seq % r->history] = frame;
+    r->seqs[seq % r->history] = seq;
+    r->latestSeq = seq;
+    r->latestTick = tick;
+    return seq;
+}
+
+const BodyState* Snapshot_Latest(const SnapReceiver* r) {
+    if (0 == r->latestSeq) {
+        return NULL;
+    }
+    return r->frames[r->latestSeq % r->history];
+}
+
+size_t Snapshot_EncodeLevel(const BodyState* states, i32 capacity, u8* buf, size_t bufSize) {
+    if (bufSize < Snapshot_MaxSize(capacity)) {
+        return 0;
+    }
+
+    u16 count = 0;
+    for (i32 i = 0; i < capacity; i++) {
+        count += BODYTYPE_NULL != states[i].type && states[i].isStatic;
+    }
+
+    BitWriter w;
+    Bits_WriterInit(&w, buf, bufSize);
+    Bits_Write(&w, MSGTYPE_C_LEVEL_LOAD, MSGTYPE_BITS);
+    Bits_Write(&w, count, 16);
+
+    const i32 idBits = Bits_Range(0, capacity - 1);
+    for (i32 i = 0; i < capacity; i++) {
+        if (BODYTYPE_NULL == states[i].type || !states[i].isStatic) {
+            continue;
+        }
+
+        Bits_Write(&w, i, idBits);
+        WriteSpawn(&w, &states[i]);
+
+        // static geometry is sent once so it can afford full precision
+        for (i32 j = 0; j < 3; j++) {
+            Bits_WriteF32(&w, states[i].transform[12 + j]);
+        }
+        for (i32 j = 0; j < 9; j++) {
+            Bits_WriteF32(&w, states[i].transform[rotIndices[j]]);
+        }
+    }
+
+    return w.overflow ? 0 : Bits_WriterBytes(&w);
+}
+
+i32 Snapshot_DecodeLevel(BodyState* states, i32 capacity, const u8* data, size_t len) {
+    BitReader rd;
+    Bits_ReaderInit(&rd, data, len);
+    const u32 type = Bits_Read(&rd, MSGTYPE_BITS);
+    const u32 count = Bits_Read(&rd, 16);
+    if (rd.failed || MSGTYPE_C_LEVEL_LOAD != type) {
+        return -1;
+    }
+
+    for (u32 n = 0; n < count; n++) {
+        BodyState* body = &states[Bits_ReadRange(&rd, 0, capacity - 1)];
+        if (!ReadSpawn(&rd, body)) {
+            return -1;
+        }
+
+        for (i32 j = 0; j < 3; j++) {
+            body->transform[12 + j] = Bits_ReadF32(&rd);
+        }
+        for (i32 j = 0; j < 9; j++) {
+            body->transform[rotIndices[j]] = Bits_ReadF32(&rd);
+        }
+        body->transform[3] = body->transform[7] = body->transform[11] = 0.0;
+        body->transform[15] = 1.0;
+        body->isStatic = 1;
+        body->isAwake = 0;
+    }
+
+    return Bits_ReaderDone(&rd) ? (i32)count : -1;
+}
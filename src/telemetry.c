@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/telemetry.h"
+#include "../inc/log.h"
+
+static i32 Bucket(size_t len) {
+    i32 bucket = 0;
+    for (size_t size = 64; len >= size && bucket < TELEMETRY_SIZE_BUCKETS - 1; size <<= 1) {
+        bucket++;
+    }
+    return bucket;
+}
+
+i8 Telemetry_Init(Telemetry* t, const i8* path, i32 capacity) {
+    memset(t, 0, sizeof(*t));
+    t->worstPeer = -1;
+    t->capacity = capacity;
+    t->peers = calloc(capacity, sizeof(PeerTelemetry));
+    if (!t->peers) {
+        return 1;
+    }
+    if (path) {
+        t->out = fopen(path, "w");
+        if (!t->out) {
+            free(t->peers);
+            t->peers = NULL;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void WriteArray(FILE* out, const i8* key, const u64* values, i32 count) {
+    fprintf(out, ",\"%s\":[", key);
+    for (i32 i = 0; i < count; i++) {
+        fprintf(out, i ? ",%llu" : "%llu", (unsigned long long)values[i]);
+    }
+    fputc(']', out);
+}
+
+static void WriteSizes(Telemetry* t, u64 tick, f64 now) {
+    for (i32 type = 0; type < MSGTYPE_COUNT; type++) {
+        for (i32 dir = 0; dir < 2; dir++) {
+            const u64* buckets = dir ? t->receivedSizes[type] : t->sentSizes[type];
+            u64 total = 0;
+            for (i32 i = 0; i < TELEMETRY_SIZE_BUCKETS; i++) {
+                total += buckets[i];
+            }
+            if (0 == total) {
+                continue;
+            }
+            fprintf(t->out, "{\"type\":\"sizes\",\"t\":%.4f,\"tick\":%llu,\"msg\":\"%s\",\"dir\":\"%s\"",
+                now - t->start, (unsigned long long)tick, Msg_TypeName(type), dir ? "received" : "sent");
+            WriteArray(t->out, "buckets", buckets, TELEMETRY_SIZE_BUCKETS);
+            fputs("}\n", t->out);
+        }
+    }
+}
+
+void Telemetry_Free(Telemetry* t) {
+    for (i32 type = 0; type < MSGTYPE_COUNT; type++) {
+        const u64* b = t->sentSizes[type];
+        u64 total = 0;
+        for (i32 i = 0; i < TELEMETRY_SIZE_BUCKETS; i++) {
+            total += b[i];
+        }
+        if (total > 0) {
+            Log_Write(LOGLEVEL_INFO, "msg_sizes", "msg=%s sent=%llu lt64=%llu lt128=%llu lt256=%llu lt512=%llu lt1k=%llu lt2k=%llu lt4k=%llu ge4k=%llu", Msg_TypeName(type), (unsigned long long)total,
+                (unsigned long long)b[0], (unsigned long long)b[1], (unsigned long long)b[2], (unsigned long long)b[3],
+                (unsigned long long)b[4], (unsigned long long)b[5], (unsigned long long)b[6], (unsigned long long)b[7]);
+        }
+    }
+
+    if (t->out) {
+        fclose(t->out);
+        t->out = NULL;
+    }
+    free(t->peers);
+    t->peers = NULL;
+}
+
+void Telemetry_ResetPeer(Telemetry* t, i32 slot) {
+    memset(&t->peers[slot], 0, sizeof(PeerTelemetry));
+}
+
+void Telemetry_CountSent(Telemetry* t, i32 slot, u8 channel, const u8* data, size_t len) {
+    const i32 type = Msg_Type(data, len);
+    if (-1 != type) {
+        t->sentSizes[type][Bucket(len)]++;
+    }
+    if (-1 != slot && channel < CHANNEL_COUNT) {
+        t->peers[slot].bytesSent[channel] += len;
+        t->peers[slot].packetsSent[channel]++;
+    }
+}
+
+void Telemetry_CountReceived(Telemetry* t, i32 slot, u8 channel, const u8* data, size_t len) {
+    const i32 type = Msg_Type(data, len);
+    if (-1 != type) {
+        t->receivedSizes[type][Bucket(len)]++;
+    }
+    if (-1 != slot && channel < CHANNEL_COUNT) {
+        t->peers[slot].bytesReceived[channel] += len;
+        t->peers[slot].packetsReceived[channel]++;
+    }
+}
+
+void Telemetry_Sample(Telemetry* t, u64 tick, ENetPeer* const* peers, f64 now) {
+    if (0.0 == t->start) {
+        t->start = now;
+        t->nextSizes = now + TELEMETRY_SIZES_TIME;
+    }
+
+    t->worstPeer = -1;
+    t->worstRtt = t->worstLoss = 0;
+    for (i32 i = 0; i < t->capacity; i++) {
+        const ENetPeer* peer = peers[i];
+        if (!peer) {
+            continue;
+        }
+        PeerTelemetry* p = &t->peers[i];
+        p->peakRtt = peer->roundTripTime > p->peakRtt ? peer->roundTripTime : p->peakRtt;
+        if (-1 == t->worstPeer || peer->roundTripTime > t->worstRtt) {
+            t->worstPeer = i;
+            t->worstRtt = peer->roundTripTime;
+            t->worstLoss = peer->packetLoss;
+        }
+        if (!t->out) {
+            continue;
+        }
+
+        // enet's own queue of commands not yet handed to the socket, reliable ones
+        // waiting for an ack are in reliableDataInTransit instead
+        fprintf(t->out, "{\"type\":\"peer\",\"t\":%.4f,\"tick\":%llu,\"peer\":%d,\"rtt_ms\":%u,\"rtt_var_ms\":%u,\"peak_rtt_ms\":%u,\"loss\":%.4f,\"reliable_in_transit\":%u,\"queued\":%zu",
+            now - t->start, (unsigned long long)tick, i, peer->roundTripTime, peer->roundTripTimeVariance, p->peakRtt,
+            peer->packetLoss / (f64)ENET_PEER_PACKET_LOSS_SCALE, peer->reliableDataInTransit, enet_list_size((ENetList*)&peer->outgoingCommands));
+        WriteArray(t->out, "bytes_sent", p->bytesSent, CHANNEL_COUNT);
+        WriteArray(t->out, "bytes_received", p->bytesReceived, CHANNEL_COUNT);
+        WriteArray(t->out, "packets_sent", p->packetsSent, CHANNEL_COUNT);
+        WriteArray(t->out, "packets_received", p->packetsReceived, CHANNEL_COUNT);
+        fputs("}\n", t->out);
+    }
+
+    if (t->out && now >= t->nextSizes) {
+        WriteSizes(t, tick, now);
+        t->nextSizes += TELEMETRY_SIZES_TIME;
+    }
+}
@@ -0,0 +1,77 @@
+#include <errno.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#include "../inc/tick.h"
+
+f64 Tick_Now(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq = {0};
+    if (0 == freq.QuadPart) {
+        QueryPerformanceFrequency(&freq);
+    }
+    LARGE_INTEGER count;
+    QueryPerformanceCounter(&count);
+    return (f64)count.QuadPart / (f64)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+void Tick_Init(TickClock* c, f64 rate, i32 maxCatchUp) {
+    c->tickTime = 1.0 / rate;
+    c->maxCatchUp = maxCatchUp < 1 ? 1 : maxCatchUp;
+    c->nextTick = Tick_Now() + c->tickTime;
+    c->ticks = c->overruns = c->droppedTicks = 0;
+}
+
+i32 Tick_Due(TickClock* c) {
+    const f64 now = Tick_Now();
+    if (now < c->nextTick) {
+        return 0;
+    }
+
+    const i64 due = (i64)((now - c->nextTick) / c->tickTime) + 1;
+    if (due > c->maxCatchUp) {
+        // too far behind to ever catch up, drop the backlog instead of
+        // running even more ticks next time around
+        c->overruns++;
+        c->droppedTicks += due - c->maxCatchUp;
+        c->nextTick = now + c->tickTime;
+        c->ticks += c->maxCatchUp;
+        return c->maxCatchUp;
+    }
+
+    c->nextTick += due * c->tickTime;
+    c->ticks += due;
+    return (i32)due;
+}
+
+f64 Tick_Remaining(const TickClock* c) {
+    const f64 remaining = c->nextTick - Tick_Now();
+    return remaining > 0.0 ? remaining : 0.0;
+}
+
+void Tick_SleepUntil(f64 time) {
+#ifdef _WIN32
+    const f64 remaining = time - Tick_Now();
+    if (remaining > 0.0) {
+        Sleep((DWORD)(remaining * 1000.0));
+    }
+    while (Tick_Now() < time); // sleep only has ms resolution
+#else
+    const f64 remaining = time - Tick_Now();
+    if (remaining <= 0.0) {
+        return;
+    }
+    // rounding can land exactly on a whole second, which nanosleep refuses
+    const long nsec = (long)((remaining - (time_t)remaining) * 1e9);
+    struct timespec ts = { .tv_sec = (time_t)remaining, .tv_nsec = nsec > 999999999L ? 999999999L : nsec };
+    while (nanosleep(&ts, &ts) != 0 && EINTR == errno); // resume if interrupted by a signal
+#endif
+}
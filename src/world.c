@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/world.h"
+#include "../inc/prof.h"
+#include "../inc/tick.h"
+#include "../inc/transform.h"
+
+static void NearCallback(void* data, dGeomID o1, dGeomID o2);
+
+// returns the number of threads stepping the world
+static i32 StartThreads(World* w, i32 threads) {
+    w->threading = NULL;
+    w->pool = NULL;
+    if (threads <= 1) {
+        return 1;
+    }
+
+    w->threading = dThreadingAllocateMultiThreadedImplementation();
+    if (!w->threading) {
+        return 1;
+    }
+    w->pool = dThreadingAllocateThreadPool(threads, 0, dAllocateFlagBasicData, NULL);
+    if (!w->pool) {
+        dThreadingFreeImplementation(w->threading);
+        w->threading = NULL;
+        return 1;
+    }
+
+    dThreadingThreadPoolServeMultiThreadedImplementation(w->pool, w->threading);
+    dWorldSetStepThreadingImplementation(w->world, dThreadingImplementationGetFunctions(w->threading), w->threading);
+    dWorldSetStepIslandsProcessingMaxThreadCount(w->world, threads);
+    return threads;
+}
+
+static void StopThreads(World* w) {
+    if (!w->threading) {
+        return;
+    }
+    dThreadingImplementationShutdownProcessing(w->threading);
+    dThreadingFreeThreadPool(w->pool);
+    dWorldSetStepThreadingImplementation(w->world, NULL, NULL);
+    dThreadingFreeImplementation(w->threading);
+    w->threading = NULL;
+    w->pool = NULL;
+}
+
+static dSpaceID CreateSpace(const WorldConfig* config) {
+    switch (config->broadphase) {
+        case BROADPHASE_SAP: return dSweepAndPruneSpaceCreate(0, dSAP_AXES_XZY);
+        case BROADPHASE_QUADTREE: {
+            const Vector3 min = config->boundsMin;
+            const Vector3 max = config->boundsMax;
+            const dVector3 center = { (min.x + max.x) * 0.5, (min.y + max.y) * 0.5, (min.z + max.z) * 0.5 };
+            const dVector3 extents = { (max.x - min.x) * 0.5, (max.y - min.y) * 0.5, (max.z - min.z) * 0.5 };
+            return dQuadTreeSpaceCreate(0, center, extents, config->quadDepth);
+        }
+        case BROADPHASE_SIMPLE: return dSimpleSpaceCreate(0);
+        default: {
+            const dSpaceID space = dHashSpaceCreate(0);
+            dHashSpaceSetLevels(space, config->hashMinLevel, config->hashMaxLevel);
+            return space;
+        }
+    }
+}
+
+i8 World_Init(World* w, i32 capacity, const WorldConfig* config) {
+    w->bodies = malloc(sizeof(Body) * capacity);
+    w->states = malloc(sizeof(BodyState) * capacity);
+    w->dynamicIDs = malloc(sizeof(i32) * capacity);
+    if (!w->bodies || !w->states || !w->dynamicIDs) {
+        free(w->bodies);
+        free(w->states);
+        free(w->dynamicIDs);
+        return 1;
+    }
+
+    w->capacity = capacity;
+    w->dynamicCount = 0;
+    w->awakeCount = 0;
+    w->stepContacts = 0;
+    w->totalContacts = 0;
+    w->stepPairs = 0;
+    w->stepNarrow = 0;
+    w->collideTime = 0.0;
+    w->config = *config;
+    w->quick = STEPPER_QUICK == config->stepper;
+    w->quickSteps = 0;
+    for (i32 i = 0; i < capacity; i++) {
+        w->bodies[i].type = w->states[i].type = BODYTYPE_NULL;
+        w->bodies[i].body = NULL;
+        w->bodies[i].geom = NULL;
+    }
+
+    w->world = dWorldCreate();
+    dWorldSetGravity(w->world, 0.0, -9.8, 0.0);
+    dWorldSetQuickStepNumIterations(w->world, config->quickIterations);
+    dWorldSetQuickStepW(w->world, config->quickSOR);
+    // bodies copy these when they're created
+    dWorldSetAutoDisableFlag(w->world, config->sleep);
+    dWorldSetAutoDisableLinearThreshold(w->world, config->sleepLinear);
+    dWorldSetAutoDisableAngularThreshold(w->world, config->sleepAngular);
+    dWorldSetAutoDisableSteps(w->world, config->sleepSteps);
+    dWorldSetAutoDisableTime(w->world, 0.0);
+    w->threads = StartThreads(w, config->threads);
+    w->space = CreateSpace(config);
+    // the map is a handful of boxes
+    w->staticSpace = dSimpleSpaceCreate(0);
+    w->contactGroup = dJointGroupCreate(0);
+    return 0;
+}
+
+void World_Destroy(World* w) {
+    for (i32 i = 0; i < w->capacity; i++) {
+        if (BODYTYPE_NULL == w->bodies[i].type) {
+            continue;
+        }
+        if (w->bodies[i].body) {
+            dBodyDestroy(w->bodies[i].body);
+        }
+        dGeomDestroy(w->bodies[i].geom);
+    }
+
+    dJointGroupDestroy(w->contactGroup);
+    dSpaceDestroy(w->space);
+    dSpaceDestroy(w->staticSpace);
+    StopThreads(w);
+    dWorldDestroy(w->world);
+
+    free(w->bodies);
+    free(w->states);
+    free(w->dynamicIDs);
+    w->bodies = NULL;
+    w->states = NULL;
+    w->dynamicIDs = NULL;
+    w->capacity = 0;
+    w->dynamicCount = 0;
+    w->awakeCount = 0;
+}
+
+i32 World_AddBody(World* w, CollMask category, CollMask collide, BodyState state, i8 isKinematic) {
+    for (i32 i = 0; i < w->capacity; i++) {
+        if (w->bodies[i].type != BODYTYPE_NULL) {
+            continue;
+        }
+
+        Body* body = &w->bodies[i];
+        switch (state.type) {
+            case BODYTYPE_SPHERE: {
+                body->geom = dCreateSphere(w->space, state.size.x);
+            } break;
+            case BODYTYPE_BOX: {
+                body->geom = dCreateBox(w->space, state.size.x, state.size.y, state.size.z);
+            } break;
+            default: return -1;
+        }
+
+        body->type = state.type;
+        body->body = dBodyCreate(w->world);
+
+        dReal pos[3], rm[12];
+        GetTransMatPos(pos, state.transform);
+        GetTransMatRot(rm, state.transform);
+        dBodySetPosition(body->body, pos[0], pos[1], pos[2]);
+        dBodySetRotation(body->body, rm);
+
+        if (isKinematic) {
+            dBodySetKinematic(body->body);
+        }
+
+        dGeomSetCategoryBits(body->geom, category);
+        dGeomSetCollideBits(body->geom, collide);
+        dGeomSetBody(body->geom, body->body);
+
+        w->states[i] = state;
+        w->states[i].isStatic = 0;
+        w->states[i].isAwake = 1;
+        w->dynamicIDs[w->dynamicCount++] = i;
+        return i;
+    }
+
+    return -1;
+}
+
+i32 World_AddBodyMap(World* w, Vector3 pos, Vector3 rot, Vector3 size, Color col) {
+    for (i32 i = 0; i < w->capacity; i++) {
+        if (w->bodies[i].type != BODYTYPE_NULL) {
+            continue;
+        }
+
+        Body* body = &w->bodies[i];
+        body->type = BODYTYPE_BOX;
+        body->geom = dCreateBox(w->staticSpace, size.x, size.y, size.z);
+
+        dReal trans[16], rm[12];
+        GetTransformMatV(trans, pos, rot);
+        GetTransMatRot(rm, trans);
+        dGeomSetPosition(body->geom, pos.x, pos.y, pos.z);
+        dGeomSetRotation(body->geom, rm);
+
+        dGeomSetCategoryBits(body->geom, CMASK_MAP);
+        dGeomSetCollideBits(body->geom, CMASK_ALL & ~CMASK_MAP);
+        body->body = NULL;
+
+        w->states[i] = (BodyState){ .size = size, .col = col, .type = BODYTYPE_BOX, .isStatic = 1 };
+        memcpy(w->states[i].transform, trans, sizeof(dReal) * 16);
+        return i;
+    }
+
+    return -1;
+}
+
+void World_AddDefaultMap(World* w) {
+    World_AddBodyMap(w, (Vector3){0.f, 0.f, 0.f}, (Vector3){0.f, 0.f, 0.f}, (Vector3){100.f, 1.f, 100.f}, DARKGRAY);
+
+    World_AddBodyMap(w, (Vector3){4.f, 3.f, 0.f}, (Vector3){0.f, 0.f, -0.5f}, (Vector3){0.5f, 8.f, 12.f}, RED);
+    // World_AddBodyMap(w, (Vector3){-4.f, 3.f, 0.f}, (Vector3){0.f, 0.f, 0.5f}, (Vector3){0.5f, 8.f, 12.f}, YELLOW);
+    World_AddBodyMap(w, (Vector3){0.f, 3.f, 6.f}, (Vector3){0.f, 0.f, 0.f}, (Vector3){12.f, 8.f, 0.5f}, GREEN);
+    World_AddBodyMap(w, (Vector3){0.f, 3.f, -6.f}, (Vector3){0.f, 0.f, 0.f}, (Vector3){12.f, 8.f, 0.5f}, BLUE);
+}
+
+void World_Step(World* w, dReal dt) {
+    w->stepContacts = 0;
+    w->stepPairs = 0;
+    w->stepNarrow = 0;
+    PROF_BEGIN(PROF_COLLIDE);
+    const f64 collideStart = Tick_Now();
+    // dynamic against dynamic, then dynamic against the map. map pairs never come up
+    dSpaceCollide(w->space, w, NearCallback);
+    dSpaceCollide2((dGeomID)w->space, (dGeomID)w->staticSpace, w, NearCallback);
+    w->collideTime = Tick_Now() - collideStart;
+    PROF_END(PROF_COLLIDE);
+
+    // contacts from this step's collide decide, with some slack so a pile sitting
+    // right at the threshold doesn't flip every tick
+    if (STEPPER_AUTO == w->config.stepper) {
+        if (!w->quick && w->stepContacts > w->config.quickAbove) {
+            w->quick = 1;
+        } else if (w->quick && w->stepContacts < w->config.exactBelow) {
+            w->quick = 0;
+        }
+    }
+
+    PROF_BEGIN(PROF_WORLD_STEP);
+    if (w->quick) {
+        dWorldQuickStep(w->world, dt);
+        w->quickSteps++;
+    } else {
+        dWorldStep(w->world, dt);
+    }
+    PROF_END(PROF_WORLD_STEP);
+    dJointGroupEmpty(w->contactGroup);
+    w->totalContacts += w->stepContacts;
+}
+
+static const i8* stepperNames[] = {
+    [STEPPER_EXACT] = "exact",
+    [STEPPER_QUICK] = "quick",
+    [STEPPER_AUTO] = "auto"
+};
+
+static const i8* broadphaseNames[] = {
+    [BROADPHASE_HASH] = "hash",
+    [BROADPHASE_SAP] = "sap",
+    [BROADPHASE_QUADTREE] = "quadtree",
+    [BROADPHASE_SIMPLE] = "simple"
+};
+
+// index of name in names, -1 if it isn't there
+static i32 FindName(const i8* const* names, i32 count, const i8* name) {
+    for (i32 i = 0; i < count; i++) {
+        if (0 == strcmp(name, names[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const i8* World_StepperName(WorldStepper stepper) {
+    return stepperNames[stepper];
+}
+
+i8 World_ParseStepper(const i8* name, WorldStepper* stepper) {
+    const i32 i = FindName(stepperNames, sizeof(stepperNames) / sizeof(stepperNames[0]), name);
+    if (i < 0) {
+        return 1;
+    }
+    *stepper = i;
+    return 0;
+}
+
+const i8* World_BroadphaseName(WorldBroadphase broadphase) {
+    return broadphaseNames[broadphase];
+}
+
+i8 World_ParseBroadphase(const i8* name, WorldBroadphase* broadphase) {
+    const i32 i = FindName(broadphaseNames, sizeof(broadphaseNames) / sizeof(broadphaseNames[0]), name);
+    if (i < 0) {
+        return 1;
+    }
+    *broadphase = i;
+    return 0;
+}
+
+void World_ExtractStates(World* w) {
+    PROF_BEGIN(PROF_EXTRACT);
+    w->awakeCount = 0;
+    for (i32 n = 0; n < w->dynamicCount; n++) {
+        const i32 i = w->dynamicIDs[n];
+        const dBodyID body = w->bodies[i].body;
+
+        // disabled bodies haven't moved since they were last copied, their transform is still right
+        const u8 awake = dBodyIsEnabled(body);
+        if (!awake && !w->states[i].isAwake) {
+            continue;
+        }
+
+        w->states[i].isAwake = awake;
+        w->awakeCount += awake;
+        GetTransformMat(w->states[i].transform, dBodyGetPosition(body), dBodyGetRotation(body));
+    }
+    PROF_END(PROF_EXTRACT);
+}
+
+static void NearCallback(void* data, dGeomID o1, dGeomID o2) {
+    World* w = data;
+    w->stepPairs++;
+
+    // the spaces already dropped pairs whose category and collide bits don't match.
+    // nothing awake on either side, ode would ignore the joints anyway
+    const dBodyID b1 = dGeomGetBody(o1);
+    const dBodyID b2 = dGeomGetBody(o2);
+    if ((!b1 || !dBodyIsEnabled(b1)) && (!b2 || !dBodyIsEnabled(b2))) {
+        return;
+    }
+
+    w->stepNarrow++;
+    const i32 MAX_CONTACTS = 8;
+    dContact contacts[MAX_CONTACTS];
+
+    const i32 nc = dCollide(o1, o2, MAX_CONTACTS, &contacts[0].geom, sizeof(dContact));
+    if (nc <= 0) {
+        return;
+    }
+
+    w->stepContacts += nc;
+    for (i32 i = 0; i < nc; i++) {
+        contacts[i].surface.mode = dContactBounce; // Enable bounce
+        contacts[i].surface.bounce = 0.2;          // Bounce factor
+        contacts[i].surface.bounce_vel = 0.1;      // Minimum velocity for bounce
+        contacts[i].surface.mu = dInfinity;        // Friction coefficient
+
+        // Create a contact joint to handle the collision
+        dJointID c = dJointCreateContact(w->world, w->contactGroup, &contacts[i]);
+        dJointAttach(c, b1, b2);
+    }
+}
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/util.h"
+#include "../inc/msgs.h"
+#include "../inc/snapshot.h"
+#include "../inc/tick.h"
+#include "../inc/rand.h"
+#include "../inc/transform.h"
+
+// feeds every reader the malformed packets in tests/corpus/malformed.txt, all of which
+// have to be rejected, then mangles valid messages of every type: cut short or with a
+// byte added they have to be rejected too, with bits flipped they only must not crash.
+// build with -fsanitize=address,undefined to catch reads out of bounds.
+//   fuzz_msgs [--corpus tests/corpus/malformed.txt] [--mutations 200000] [--seed 1]
+// exits nonzero on the first packet that gets through
+
+#define MAX_PACKET 8192
+#define SAMPLE_COUNT 8
+
+typedef struct sample {
+    const i8* name;
+    u8 data[MAX_PACKET];
+    size_t len;
+} Sample;
+
+static SnapReceiver receiver;
+static BodyState level[MAX_BODIES];
+static i32 updateSlots[DEFAULT_MAX_PLAYERS];
+static PlayerState updatePlayers[DEFAULT_MAX_PLAYERS];
+
+// nonzero if a reader took the packet
+static i8 Accepts(const u8* data, size_t len) {
+    const QuantBounds bounds = QUANT_DEFAULT_BOUNDS;
+    switch (Msg_Type(data, len)) {
+        case MSGTYPE_C_PLAYER_ID: {
+            MsgPlayerID msg;
+            return 0 == Msg_ReadPlayerID(data, len, &msg);
+        }
+        case MSGTYPE_C_UPDATE_PLAYERS: {
+            MsgUpdatePlayers msg = { .capacity = DEFAULT_MAX_PLAYERS, .slots = updateSlots, .players = updatePlayers };
+            return 0 == Msg_ReadUpdatePlayers(data, len, &msg);
+        }
+        case MSGTYPE_S_PLAYER_INPUT: {
+            MsgPlayerInput msg;
+            return 0 == Msg_ReadPlayerInput(data, len, &msg);
+        }
+        case MSGTYPE_C_SNAPSHOT: {
+            // every packet is judged on its own, against a receiver that has nothing yet
+            receiver.latestSeq = 0;
+            memset(receiver.seqs, 0, sizeof(u32) * receiver.history);
+            return 0 != Snapshot_Decode(&receiver, data, len);
+        }
+        case MSGTYPE_S_NEW_BODY: {
+            MsgNewBody msg;
+            return 0 == Msg_ReadNewBody(data, len, &bounds, &msg);
+        }
+        case MSGTYPE_S_SNAPSHOT_ACK: {
+            MsgSnapshotAck msg;
+            return 0 == Msg_ReadSnapshotAck(data, len, &msg);
+        }
+        case MSGTYPE_C_LEVEL_LOAD: {
+            return -1 != Snapshot_DecodeLevel(level, MAX_BODIES, data, len);
+        }
+        case MSGTYPE_C_SERVER_STATS: {
+            MsgServerStats msg;
+            return 0 == Msg_ReadServerStats(data, len, &msg);
+        }
+        default: return 0;
+    }
+}
+
+static i32 HexValue(i8 c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// returns the number of packets that got through, or -1 if the corpus can't be read
+static i32 RunCorpus(const i8* path, i32* count, f64* seconds) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "can't open %s\n", path);
+        return -1;
+    }
+
+    i8 line[2 * MAX_PACKET + 2];
+    i8 about[256] = "";
+    u8 packet[MAX_PACKET];
+    i32 accepted = 0;
+    i32 lineNum = 0;
+    *count = 0;
+    *seconds = 0.0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNum++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if ('#' == line[0]) {
+            snprintf(about, sizeof(about), "%.*s", (i32)sizeof(about) - 1, line + 1);
+            continue;
+        }
+        if ('\0' == line[0]) {
+            continue;
+        }
+
+        size_t len = 0;
+        for (const i8* c = line; c[0] && c[1] && len < sizeof(packet); c += 2) {
+            const i32 hi = HexValue(c[0]), lo = HexValue(c[1]);
+            if (hi < 0 || lo < 0) {
+                fprintf(stderr, "%s:%d: not hex\n", path, lineNum);
+                fclose(f);
+                return -1;
+            }
+            packet[len++] = (u8)(hi << 4 | lo);
+        }
+
+        const f64 start = Tick_Now();
+        const i8 ok = Accepts(packet, len);
+        *seconds += Tick_Now() - start;
+        (*count)++;
+        if (ok) {
+            fprintf(stderr, "%s:%d: accepted:%s\n", path, lineNum, about);
+            accepted++;
+        }
+    }
+
+    fclose(f);
+    return accepted;
+}
+
+// one valid message of every type, so mangled copies start from something real
+static i8 BuildSamples(Sample* samples) {
+    i32 n = 0;
+    Sample* s;
+
+    s = &samples[n++];
+    s->name = "player_id";
+    s->len = Msg_WritePlayerID(s->data, MAX_PACKET, &(MsgPlayerID){ .playerID = 7, .maxPlayers = DEFAULT_MAX_PLAYERS, .bounds = QUANT_DEFAULT_BOUNDS, .tickTime = 1.f / 120.f, .snapshotHistory = 92 });
+
+    PlayerState ps[3];
+    i32 ss[3] = { 0, 4, 31 };
+    for (i32 i = 0; i < 3; i++) {
+        Move_Spawn(&ps[i]);
+        ps[i].id = 1 == i ? -1 : ss[i];
+        ps[i].lastInput = 100 + i;
+    }
+    s = &samples[n++];
+    s->name = "update_players";
+    s->len = Msg_WriteUpdatePlayers(s->data, MAX_PACKET, &(MsgUpdatePlayers){ .full = 0, .capacity = DEFAULT_MAX_PLAYERS, .count = 3, .slots = ss, .players = ps });
+
+    MsgPlayerInput input = { .count = 4 };
+    for (i32 i = 0; i < input.count; i++) {
+        input.inputs[i] = (PlayerInput){ .seq = 50 + i, .buttons = i & 1, .yaw = 1000 * (i / 2), .pitch = 300 };
+    }
+    s = &samples[n++];
+    s->name = "player_input";
+    s->len = Msg_WritePlayerInput(s->data, MAX_PACKET, &input);
+
+    BodyState body = { .type = BODYTYPE_BOX, .size = { 0.5f, 1.f, 0.25f }, .col = { 200, 100, 50, 255 } };
+    GetTransformMatV(body.transform, (Vector3){ 2.f, 30.f, -3.f }, (Vector3){ 0.f, 0.f, 0.f });
+    s = &samples[n++];
+    s->name = "new_body";
+    s->len = Msg_WriteNewBody(s->data, MAX_PACKET, &(MsgNewBody){ .body = body });
+
+    s = &samples[n++];
+    s->name = "snapshot_ack";
+    s->len = Msg_WriteSnapshotAck(s->data, MAX_PACKET, &(MsgSnapshotAck){ .seq = 12345 });
+
+    s = &samples[n++];
+    s->name = "server_stats";
+    s->len = Msg_WriteServerStats(s->data, MAX_PACKET, &(MsgServerStats){ .tick = 9000, .overruns = 2, .droppedTicks = 7 });
+
+    // a snapshot spawning a handful of bodies and a level with a couple of boxes in it
+    static BodyState states[MAX_BODIES];
+    i32 ids[16];
+    for (i32 i = 0; i < 16; i++) {
+        ids[i] = i * 3;
+        states[ids[i]] = body;
+        states[ids[i]].type = i & 1 ? BODYTYPE_SPHERE : BODYTYPE_BOX;
+        states[ids[i]].isAwake = i % 3 != 0;
+        GetTransformMatV(states[ids[i]].transform, (Vector3){ i * 1.5f, 10.f, 0.f }, (Vector3){ 0.f, 0.f, 0.f });
+    }
+    SnapSource src;
+    SnapClient client;
+    if (Snapshot_SourceInit(&src, MAX_BODIES, QUANT_DEFAULT_BOUNDS) != 0 || Snapshot_ClientInit(&client, MAX_BODIES, SNAPSHOT_MIN_HISTORY, 1200) != 0) {
+        return 1;
+    }
+    Snapshot_SourceUpdate(&src, states, ids, 16, 1);
+    u8* big = malloc(Snapshot_MaxSize(MAX_BODIES));
+    if (!big) {
+        return 1;
+    }
+    s = &samples[n++];
+    s->name = "snapshot";
+    s->len = Snapshot_Encode(&client, &src, ids, 16, (Vector3){ 0.f, 0.f, 0.f }, big, Snapshot_MaxSize(MAX_BODIES));
+    memcpy(s->data, big, s->len < MAX_PACKET ? s->len : 0);
+
+    static BodyState map[MAX_BODIES];
+    for (i32 i = 0; i < 3; i++) {
+        map[i] = body;
+        map[i].isStatic = 1;
+    }
+    s = &samples[n++];
+    s->name = "level_load";
+    s->len = Snapshot_EncodeLevel(map, MAX_BODIES, big, Snapshot_MaxSize(MAX_BODIES));
+    memcpy(s->data, big, s->len < MAX_PACKET ? s->len : 0);
+
+    free(big);
+    Snapshot_ClientFree(&client);
+    Snapshot_SourceFree(&src);
+
+    for (i32 i = 0; i < n; i++) {
+        if (0 == samples[i].len || samples[i].len >= MAX_PACKET || !Accepts(samples[i].data, samples[i].len)) {
+            fprintf(stderr, "valid %s message didn't decode\n", samples[i].name);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+i32 main(i32 argc, i8** argv) {
+    const i8* corpus = "tests/corpus/malformed.txt";
+    i32 mutations = 200000;
+    randState = 1;
+    for (i32 i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--corpus") && i + 1 < argc) {
+            corpus = argv[++i];
+        } else if (0 == strcmp(argv[i], "--mutations") && i + 1 < argc) {
+            mutations = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--seed") && i + 1 < argc) {
+            randState = (u32)strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--corpus FILE] [--mutations N] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (Snapshot_ReceiverInit(&receiver, MAX_BODIES, SNAPSHOT_MIN_HISTORY, QUANT_DEFAULT_BOUNDS) != 0) {
+        fprintf(stderr, "can't allocate the snapshot receiver\n");
+        return 1;
+    }
+
+    i32 corpusCount;
+    f64 corpusTime;
+    // a corpus entry getting through still runs the mutations so the summary shows both
+    const i32 leaked = RunCorpus(corpus, &corpusCount, &corpusTime);
+    if (leaked < 0) {
+        Snapshot_ReceiverFree(&receiver);
+        return 1;
+    }
+
+    static Sample samples[SAMPLE_COUNT];
+    if (BuildSamples(samples) != 0) {
+        Snapshot_ReceiverFree(&receiver);
+        return 1;
+    }
+
+    // a shortened or lengthened message always runs into the end or leaves bytes over,
+    // flipped bits can land on something that still decodes so those are only counted
+    u8 packet[MAX_PACKET + 1];
+    i32 failures = 0, flipped = 0, flippedAccepted = 0;
+    f64 mutateTime = 0.0;
+    f64 sampleTime[SAMPLE_COUNT] = {0};
+    i32 sampleRuns[SAMPLE_COUNT] = {0};
+    for (i32 m = 0; m < mutations && failures < 10; m++) {
+        const i32 si = Rand_Next() % SAMPLE_COUNT;
+        const Sample* s = &samples[si];
+        memcpy(packet, s->data, s->len);
+        size_t len = s->len;
+        const u32 kind = Rand_Next() % 4;
+        if (0 == kind) {
+            len = Rand_Next() % s->len;
+        } else if (1 == kind) {
+            packet[len++] = (u8)Rand_Next();
+        } else {
+            const u32 flips = 1 + Rand_Next() % 4;
+            for (u32 f = 0; f < flips; f++) {
+                const u32 bit = Rand_Next() % (len * 8);
+                packet[bit / 8] ^= 1u << bit % 8;
+            }
+            flipped++;
+        }
+
+        const f64 start = Tick_Now();
+        const i8 ok = Accepts(packet, len);
+        const f64 elapsed = Tick_Now() - start;
+        mutateTime += elapsed;
+        sampleTime[si] += elapsed;
+        sampleRuns[si]++;
+        if (kind >= 2) {
+            flippedAccepted += ok;
+        } else if (ok) {
+            fprintf(stderr, "%s %s to %zu bytes was accepted\n", s->name, 0 == kind ? "cut" : "grown", len);
+            failures++;
+        }
+    }
+
+    printf("corpus=%d rejected=%d ns_per_packet=%.0f\n", corpusCount, corpusCount - leaked, corpusCount > 0 ? corpusTime * 1e9 / corpusCount : 0.0);
+    printf("mutations=%d failures=%d flipped=%d flipped_accepted=%d ns_per_packet=%.0f\n", mutations, failures, flipped, flippedAccepted, mutations > 0 ? mutateTime * 1e9 / mutations : 0.0);
+    for (i32 i = 0; i < SAMPLE_COUNT; i++) {
+        printf("msg=%s mutations=%d ns_per_packet=%.0f\n", samples[i].name, sampleRuns[i], sampleRuns[i] > 0 ? sampleTime[i] * 1e9 / sampleRuns[i] : 0.0);
+    }
+
+    Snapshot_ReceiverFree(&receiver);
+    return leaked > 0 || failures > 0;
+}
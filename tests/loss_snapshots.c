@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../inc/util.h"
+#include "../inc/msgs.h"
+#include "../inc/bits.h"
+#include "../inc/snapshot.h"
+#include "../inc/impair.h"
+#include "../inc/transform.h"
+
+// runs the server's snapshot encoder and a client's decoder against each other through
+// two ImpairLinks, snapshots one way and acks the other, on simulated time so it takes
+// no real time and gives the same result every run. fails if:
+//   a snapshot newer than the one applied arrives and the client can't apply it, since
+//     without reliable delivery nothing else would ever fix that
+//   the applied state gets older than MAX_AGE behind the server
+//   the server has to drop the baseline and start the client over once it's running
+//   the client doesn't end up with exactly what the server has once the link clears up
+//   loss_snapshots [--seconds 120] [--latency 50] [--jitter 10] [--loss 10] [--dup PCT] [--reorder 1]
+//                  [--rate KBITS] [--queue MS] [--seed 1]
+
+#define TICK_RATE 120.0
+#define BROADCAST_TICKS 2 // 60hz, the server's defaults
+#define BODY_COUNT 48
+#define CAPACITY 64
+#define BUDGET 1200
+#define MAX_RTT 1.5
+#define SETTLE_SECONDS 2.0 // loss free and standing still at the end so the last changes get through
+
+// every snapshot that arrives after the applied one has to apply, its baseline was acked
+// so the client still has it
+#define MAX_SEQ_LAG 0
+// one way latency plus jitter, plus the time to replace up to eight lost snapshots in a row
+// and another interval to the next broadcast. at 10% loss eight in a row is a 1e-8 chance per
+// snapshot, a 120s run sends 7200 of them so about one run in fourteen thousand goes over
+#define MAX_AGE(latency, jitter) ((latency) + (jitter) + 9.0 * BROADCAST_TICKS / TICK_RATE + 0.005)
+
+typedef struct testConfig {
+    f64 seconds;
+    ImpairSettings link;
+    u64 seed;
+} TestConfig;
+
+// bodies go around in circles at different speeds, and every couple of seconds
+// a few of them disappear or come back so removes and spawns go over the lossy link too
+static void UpdateBodies(BodyState* states, u32 tick) {
+    const f64 t = tick / TICK_RATE;
+    for (i32 i = 0; i < BODY_COUNT; i++) {
+        BodyState* s = &states[i];
+        const u8 gone = i % 7 == 0 && (tick / 240 + i) % 3 == 0;
+        if (gone) {
+            s->type = BODYTYPE_NULL;
+            continue;
+        }
+
+        s->type = i & 1 ? BODYTYPE_BOX : BODYTYPE_SPHERE;
+        s->size = (Vector3){ 0.5f, 0.5f, 0.5f };
+        s->col = (Color){ 100, 150, 200, 255 };
+        // every fifth one lies still and goes to sleep
+        s->isAwake = i % 5 != 0;
+        const f64 speed = s->isAwake ? 0.5 + 0.05 * i : 0.0;
+        const Vector3 pos = { (i % 8) * 4.f - 16.f + 2.f * cos(t * speed), 10.f + 0.1f * i, (i / 8) * 4.f - 12.f + 2.f * sin(t * speed) };
+        GetTransformMatV(s->transform, pos, (Vector3){ 0.f, t * speed, 0.f });
+    }
+}
+
+static u32 PacketSeq(const u8* data, size_t len, u32* baselineSeq) {
+    BitReader r;
+    Bits_ReaderInit(&r, data, len);
+    Bits_Read(&r, MSGTYPE_BITS);
+    const u32 seq = Bits_Read(&r, 32);
+    *baselineSeq = Bits_Read(&r, 32);
+    return seq;
+}
+
+static i8 Run(const TestConfig* config) {
+    const QuantBounds bounds = QUANT_DEFAULT_BOUNDS;
+    const i32 history = Snapshot_HistoryFor(MAX_RTT, TICK_RATE / BROADCAST_TICKS);
+    const size_t bufSize = Snapshot_MaxSize(CAPACITY);
+
+    static BodyState states[CAPACITY];
+    i32 ids[CAPACITY];
+    for (i32 i = 0; i < CAPACITY; i++) {
+        ids[i] = i;
+    }
+
+    SnapSource src;
+    SnapClient client;
+    SnapReceiver receiver;
+    ImpairLink down, up;
+    u8* buf = malloc(bufSize);
+    if (!buf || Snapshot_SourceInit(&src, CAPACITY, bounds) != 0 || Snapshot_ClientInit(&client, CAPACITY, history, BUDGET) != 0 || Snapshot_ReceiverInit(&receiver, CAPACITY, history, bounds) != 0) {
+        fprintf(stderr, "alloc failed\n");
+        return 1;
+    }
+    Impair_Init(&down, config->link, config->seed);
+    Impair_Init(&up, config->link, config->seed + 1);
+
+    const u32 lossyTicks = (u32)(config->seconds * TICK_RATE);
+    const u32 totalTicks = lossyTicks + (u32)(SETTLE_SECONDS * TICK_RATE);
+    const f64 maxAge = MAX_AGE(config->link.latency, config->link.jitter);
+    u32 newestSeen = 0, worstLag = 0, resets = 0, received = 0, applied = 0;
+    f64 worstAge = 0.0, ageSum = 0.0;
+    u32 ageSamples = 0;
+    i8 failed = 0;
+
+    for (u32 tick = 1; tick <= totalTicks && !failed; tick++) {
+        const f64 now = tick / TICK_RATE;
+        if (tick == lossyTicks) {
+            down.settings = up.settings = (ImpairSettings){ .latency = config->link.latency, .queueTime = config->link.queueTime };
+        }
+
+        // everything stops moving once the link clears so the client can catch up exactly
+        UpdateBodies(states, tick < lossyTicks ? tick : lossyTicks);
+        if (0 == tick % BROADCAST_TICKS) {
+            Snapshot_SourceUpdate(&src, states, ids, CAPACITY, tick);
+            i32 visible[CAPACITY], visibleCount = 0;
+            for (i32 i = 0; i < CAPACITY; i++) {
+                if (BODYTYPE_NULL != states[i].type) {
+                    visible[visibleCount++] = i;
+                }
+            }
+            const size_t len = Snapshot_Encode(&client, &src, visible, visibleCount, (Vector3){ 0.f, 10.f, 0.f }, buf, bufSize);
+            // the first few go out before any ack could have come back
+            u32 baselineSeq;
+            PacketSeq(buf, len, &baselineSeq);
+            if (0 == baselineSeq && tick > TICK_RATE) {
+                resets++;
+            }
+            if (0 == len || Impair_Push(&down, buf, len, now) != 0) {
+                fprintf(stderr, "tick=%u couldn't encode or queue a snapshot\n", tick);
+                failed = 1;
+            }
+        }
+
+        ImpairPacket packet;
+        while (Impair_Pop(&down, now, &packet)) {
+            received++;
+            u32 baselineSeq;
+            const u32 seq = PacketSeq(packet.data, packet.len, &baselineSeq);
+            newestSeen = seq > newestSeen ? seq : newestSeen;
+            const u32 ack = Snapshot_Decode(&receiver, packet.data, packet.len);
+            free(packet.data);
+            if (0 == ack) {
+                continue; // older than what's applied, unreliable sequenced drops these too
+            }
+            applied++;
+
+            u8 ackBuf[MSG_MAX_SIZE];
+            const size_t ackLen = Msg_WriteSnapshotAck(ackBuf, sizeof(ackBuf), &(MsgSnapshotAck){ .seq = ack });
+            Impair_Push(&up, ackBuf, ackLen, now);
+        }
+        while (Impair_Pop(&up, now, &packet)) {
+            MsgSnapshotAck ack;
+            if (0 == Msg_ReadSnapshotAck(packet.data, packet.len, &ack)) {
+                Snapshot_ClientAck(&client, ack.seq);
+            }
+            free(packet.data);
+        }
+
+        const u32 lag = newestSeen - receiver.latestSeq;
+        worstLag = lag > worstLag ? lag : worstLag;
+        if (lag > MAX_SEQ_LAG) {
+            fprintf(stderr, "tick=%u newest_seen=%u applied=%u\n", tick, newestSeen, receiver.latestSeq);
+            failed = 1;
+        }
+        // how old the newest state the client could draw is, once the first one is in
+        if (receiver.latestSeq != 0) {
+            const f64 age = (tick - receiver.latestTick) / TICK_RATE;
+            worstAge = age > worstAge ? age : worstAge;
+            ageSum += age;
+            ageSamples++;
+            if (age > maxAge) {
+                fprintf(stderr, "tick=%u age_ms=%.1f max_ms=%.1f\n", tick, age * 1000.0, maxAge * 1000.0);
+                failed = 1;
+            }
+        }
+    }
+
+    // with the link clear for a while the client has to have what the server has
+    const BodyState* latest = Snapshot_Latest(&receiver);
+    i32 mismatched = 0;
+    for (i32 i = 0; i < CAPACITY && latest; i++) {
+        const NetBody* want = &src.bodies[i];
+        if (!want->present || BODYTYPE_NULL == latest[i].type) {
+            mismatched += want->present != (BODYTYPE_NULL != latest[i].type);
+            continue;
+        }
+        u16 pos[3];
+        Quant_PackPos(pos, latest[i].transform, &bounds);
+        mismatched += 0 != memcmp(pos, want->pos, sizeof(pos)) || Quant_PackRot(latest[i].transform) != want->rot || latest[i].isAwake == want->asleep;
+    }
+
+    printf("seconds=%.0f loss=%.0f latency_ms=%.0f jitter_ms=%.0f history=%d sent=%u received=%u applied=%u resets=%u worst_seq_lag=%u mean_age_ms=%.1f worst_age_ms=%.1f max_age_ms=%.1f mismatched=%d lost=%llu acks_lost=%llu\n",
+        config->seconds, config->link.loss * 100.0, config->link.latency * 1000.0, config->link.jitter * 1000.0, history,
+        client.nextSeq - 1, received, applied, resets, worstLag, ageSamples > 0 ? ageSum / ageSamples * 1000.0 : 0.0, worstAge * 1000.0, maxAge * 1000.0,
+        mismatched, (unsigned long long)down.stats.lost, (unsigned long long)up.stats.lost);
+    if (resets > 0) {
+        fprintf(stderr, "the server lost the baseline %u times\n", resets);
+        failed = 1;
+    }
+    if (!failed && (!latest || mismatched > 0)) {
+        fprintf(stderr, "%d bodies differ from the server after the link cleared\n", mismatched);
+        failed = 1;
+    }
+
+    Impair_Free(&down);
+    Impair_Free(&up);
+    Snapshot_ReceiverFree(&receiver);
+    Snapshot_ClientFree(&client);
+    Snapshot_SourceFree(&src);
+    free(buf);
+    return failed;
+}
+
+i32 main(i32 argc, i8** argv) {
+    TestConfig config = { .seconds = 120.0, .link = IMPAIR_NONE, .seed = 1 };
+    config.link.loss = 0.1f;
+    config.link.latency = 0.05f;
+    config.link.jitter = 0.01f;
+    config.link.reorder = 0.01f;
+
+    for (i32 i = 1; i < argc; i++) {
+        // the link flags are netsim's, see Impair_ParseSetting
+        if (0 == strncmp(argv[i], "--", 2) && i + 1 < argc && Impair_ParseSetting(&config.link, argv[i] + 2, argv[i + 1]) == 0) {
+            i++;
+        } else if (0 == strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            config.seconds = atof(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--seed") && i + 1 < argc) {
+            config.seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--seconds 120] [--latency 50] [--jitter 10] [--loss 10] [--dup PCT] [--reorder 1] [--rate KBITS] [--queue MS] [--seed 1]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    return Run(&config);
+}